@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "dberror.h"
+
+// pins timed per pool size
+#define PINS 1000000
+
+// Pin latency of a buffer pool of numFrames frames over a page file of
+// numPages pages. With numPages == numFrames every pin is a hit and the time
+// is the page lookup alone. With more pages than frames, pinning them in a
+// circle misses every time under LRU and the time includes finding a victim.
+// Both should stay flat as the pool grows. Pool sizes can be given as
+// arguments.
+static double
+pinLatency (int numFrames, int numPages, ReplacementStrategy strategy)
+{
+	BM_BufferPool bm;
+	BM_PageHandle h;
+	SM_FileHandle fh;
+	struct timespec start, end;
+	unsigned int seed = 1;
+
+	// in-memory page file, the benchmark measures the pool and not the disk
+	setIOMode(SM_IO_MEMORY);
+	if (createPageFile("bench.bin") != RC_OK || openPageFile("bench.bin", &fh) != RC_OK
+		|| ensureCapacity(numPages, &fh) != RC_OK || closePageFile(&fh) != RC_OK)
+		return -1;
+
+	if (initBufferPool(&bm, "bench.bin", numFrames, strategy, NULL) != RC_OK)
+		return -1;
+	for (int i = 0; i < numFrames; i++)
+	{
+		pinPage(&bm, &h, i);
+		unpinPage(&bm, &h);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < PINS; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		pinPage(&bm, &h, numPages == numFrames ? (int)((seed >> 8) % numFrames) : i % numPages);
+		unpinPage(&bm, &h);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	shutdownBufferPool(&bm);
+	destroyPageFile("bench.bin");
+	return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / PINS;
+}
+
+int
+main (int argc, char *argv[])
+{
+	int defaultSizes[] = {16, 256, 4096, 65536};
+	int numSizes = argc > 1 ? argc - 1 : 4;
+
+	initStorageManager();
+	printf("%10s %16s %16s\n", "frames", "ns per hit", "ns per LRU miss");
+	for (int i = 0; i < numSizes; i++)
+	{
+		int numFrames = argc > 1 ? atoi(argv[i + 1]) : defaultSizes[i];
+		printf("%10d %16.1f %16.1f\n", numFrames, pinLatency(numFrames, numFrames, RS_FIFO),
+			   pinLatency(numFrames, numFrames + numFrames / 4 + 1, RS_LRU));
+	}
+	return 0;
+}
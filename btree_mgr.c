@@ -88,7 +88,7 @@ RC shutdownIndexManager()
 char *
 mgmtToHeader(TreeMtdt *tMgmt)
 {
-    char *header_Data = (char *)malloc(1 * PAGE_SIZE);
+    char *header_Data = allocPageBuffer();
     int i = 1;
     *(int *)header_Data = (*tMgmt).n;
     *(int *)(header_Data + sizeof(int) * i++) = (*tMgmt).keyType;
@@ -136,7 +136,7 @@ RC createBtree(char *idxId, DataType keyType, int n)
     char *header_Data = mgmtToHeader(tMgmt);
     result = writeStrToPage(idxId, 0, header_Data);
     free(tMgmt);
-    free(header_Data);
+    freePageBuffer(header_Data);
     return result;
 }
 
@@ -157,6 +157,8 @@ RC openBtree(BTreeHandle **tree, char *idxId)
     initBufferPool(bm, idxId, 10, RS_LRU, NULL);
     pinPage(bm, phHeader, 0);
     tMgmt = headerToMgmt(phHeader->data);
+    // header has been copied into tMgmt, release page 0 so the pool can shut down
+    unpinPage(bm, phHeader);
 
     if ((*tMgmt).nodes == 0)
     {
@@ -1017,7 +1019,7 @@ char *printTree(BTreeHandle *tree)
             if ((*node).node_pos == LEAF)
             {
                 RID *rec_ptr = (RID *)(*node).ptrs[i];
-                printf("%i.%i,", (*rec_ptr).page, (*rec_ptr).slot);
+                printf("%lld.%i,", (*rec_ptr).page, (*rec_ptr).slot);
                 if (i == (*node).keys_count - 1)
                 {
                     printf("%s", serializeValue((*node).keys[i]));
@@ -1,9 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
 
 #include "storage_mgr.h"
 #include "buffer_mgr.h"
+#include "wal_mgr.h"
 #include "dberror.h"
 
 /*
@@ -14,298 +20,1927 @@
 typedef struct Frame
 {
 	PageNumber pgNum;	   // Page number in buffer pool
-	SM_PageHandle content; // Holds content of page
+	SM_PageHandle content; // Holds content of page, the frame's slice of the arena
 
 	// Flags
 	int dirtyFlag; // Indicate modified page
-	int fixCnt;	   // No. of client utilizing the page
-	int recentCnt; // flag for LRU
+	uint64_t pin;  // fix count, loading flag and version, see PIN_COUNT
+	RC loadError;  // why the last read into the frame failed
+	int prefetched; // read in by prefetchPages, pins waiting for it collect the read
+	int lruPrev, lruNext; // neighbours in its recency list, used more and less recently
+	int queue;	   // recency list holding the frame, Q_RECENT or Q_FREQUENT
+	int refBit;	   // referenced since the CLOCK hand last passed
+	int freq;	   // LFU access count
+	int bucket;	   // LFU bucket of the frame
+	int prevInBucket, nextInBucket; // LFU neighbours in the bucket, older and newer
+	long lastRef;  // LRU-K time of the last pin
+	int missedPins;	  // hits the strategy has not counted yet, see nextUse
+	int missedQueued; // the frame is on the pool's list of frames with missed pins
+	int nextMissed;	  // next frame on that list
+	LSN lsn;	   // end of the last log record of the page
 } Frame;
 
-// Global Variables
-int buff_size = 0, rear = 0, writeCnt = 0, hit = 0;
+/*
+ * Open addressing map from page number to the frame holding it, so finding a
+ * page costs the same whatever the pool size. Linear probing over at least
+ * twice as many slots as entries keeps the probe runs short; a table filling
+ * up past that doubles. A removed entry is filled by moving later entries of
+ * its run back, so no tombstones pile up. The pool has a single page file,
+ * the page number alone is the key. ARC and 2Q keep a second one for the
+ * pages they remember after evicting them.
+ */
+typedef struct PageTableSlot
+{
+	PageNumber pgNum; // NO_PAGE when the slot is empty
+	int frameIdx;	  // frame (or ghost) holding the page
+} PageTableSlot;
+
+// Slots a table outgrew, kept until the pool is shut down because pins
+// looking pages up with no latch held may still be reading them
+typedef struct RetiredSlots
+{
+	PageTableSlot *slots;
+	struct RetiredSlots *next;
+} RetiredSlots;
+
+typedef struct PageTable
+{
+	PageTableSlot *slots;
+	int bits;  // the table has 2^bits slots
+	int count; // slots in use
+	RetiredSlots *retired;
+} PageTable;
+
+/*
+ * Pools are shared by threads. The page table is split into shards by page
+ * number, each with its own latch, so misses on pages in different shards
+ * do not wait for each other. A miss picks and claims its frame under the
+ * replacement latch and then reads the page with no latch held; pins of the
+ * page meanwhile find the frame loading and wait on the shard for the read
+ * to finish.
+ *
+ * A hit takes no latch at all. It looks the page up in its shard while the
+ * table may be changing, which can only give a stale frame or a miss, and
+ * pins the frame with a compare-and-swap of its pin word that only succeeds
+ * if the frame still holds the page and was not given to another page since
+ * (see PIN_VERSION). If either check fails it falls back to the lookup under
+ * the shard latch. Writers of the table store its slots atomically and keep
+ * the slots of a grown table until shutdown for such readers.
+ *
+ * Latches are taken in the order replacement latch, then shard latch. A
+ * frame is only given up by swapping a fix count of 0 for a new version
+ * under both latches, so a hit pinning it meanwhile makes either the swap or
+ * its own pin fail.
+ */
+#define PAGE_TABLE_SHARDS 16
+
+typedef struct PageShard
+{
+	pthread_mutex_t lock;
+	pthread_cond_t loaded; // broadcast when a page of the shard is read in
+	PageTable table;	   // page number -> frame index
+} PageShard;
+
+#define SHARD(pm, pgNum) (&(*(pm)).shards[(pgNum) & (PAGE_TABLE_SHARDS - 1)])
+
+/*
+ * Frame.pin holds all a pin checks and changes in one word: the fix count in
+ * the low 32 bits, PIN_LOADING while the page is read in and above it a
+ * version, raised each time the frame is given to another page. A pin read
+ * before the frame changed hands no longer matches the word, so the ABA of
+ * a frame evicted and loaded again cannot fool a hit.
+ */
+#define PIN_COUNT(w) ((int)((w) & 0xFFFFFFFFu))
+#define PIN_LOADING ((uint64_t)1 << 32)
+#define PIN_VERSION ((uint64_t)1 << 33)
+
+#define FIX_COUNT(frame, i) PIN_COUNT(__atomic_load_n(&(frame)[i].pin, __ATOMIC_ACQUIRE))
+
+// Whether no client is using frame i
+#define UNPINNED(frame, i) (FIX_COUNT(frame, i) == 0)
+
+/*
+ * LFU keeps the frames in buckets of equal access count, the buckets in a
+ * list of rising counts and the frames of each bucket in the order they got
+ * there. A hit moves its frame into the next bucket up and the victim is the
+ * oldest unpinned frame of the lowest bucket, so neither looks at the other
+ * frames. Once there were LFU_AGE_PERIOD pins per frame all counts are
+ * halved, so pages that were hot long ago make room for the current ones.
+ */
+#define LFU_AGE_PERIOD 8
+
+typedef struct FreqBucket
+{
+	int freq;		// access count of the frames in the bucket
+	int prev, next; // buckets with the next lower and higher count, -1 at the ends
+	int head, tail; // oldest and newest frame in the bucket
+} FreqBucket;
+
+/*
+ * LRU-K evicts the page whose K-th most recent reference is the oldest, so a
+ * page seen once by a scan goes before one the workload keeps coming back
+ * to. Time is counted in pins of the pool. Pins of a page less than
+ * correlatedPeriod after its previous pin belong to the same reference and
+ * leave its history alone; the frame is not evicted during that period
+ * unless nothing else can be. Pages with fewer than K references have an
+ * infinite K-distance and go first, oldest reference first.
+ */
+#define LRUK_DEFAULT_K 2
+
+/*
+ * The recency lists of a pool. LRU keeps every loaded frame in Q_RECENT.
+ * ARC splits the frames into T1 (Q_RECENT), pages used once lately, and T2
+ * (Q_FREQUENT), pages used again while in the pool. 2Q splits them into
+ * A1in (Q_RECENT), a FIFO of newly loaded pages, and Am (Q_FREQUENT), an LRU
+ * of pages that came back after leaving A1in.
+ *
+ * Both remember the page numbers of pages they evicted lately in ghost
+ * lists: ARC in B1 and B2, for pages out of T1 and T2, and 2Q in A1out, for
+ * pages out of A1in. A miss on a ghost tells ARC which of its lists should
+ * have been larger, it moves its target size for T1 towards it, and 2Q that
+ * the page is more than a one-off, it goes straight into Am. A scan so only
+ * ever cycles through T1 or A1in and leaves the pages used again alone.
+ */
+#define Q_RECENT 0
+#define Q_FREQUENT 1
+
+// Doubly linked list of frames or ghosts by index, most recent at the head
+typedef struct FrameList
+{
+	int head, tail; // -1 while the list is empty
+	int size;
+} FrameList;
+
+// A page ARC or 2Q evicted lately, remembered without its content
+typedef struct Ghost
+{
+	PageNumber pgNum;
+	int prev, next; // neighbours in its list, more and less recent
+	int queue;		// ghost list holding it
+} Ghost;
+
+// 2Q gives A1in a quarter of the frames and remembers half as many pages
+#define TWOQ_IN_SHARE 4
+#define TWOQ_OUT_SHARE 2
+
+// Completions collected per poll while flushing the pool
+#define FLUSH_BATCH 64
+
+/*
+ * The background flusher of a pool wakes every FLUSHER_PERIOD_MS. When more
+ * than its target share of the frames is dirty it writes the excess, at most
+ * FLUSH_BATCH frames per round so misses waiting for the page file get a
+ * turn in between. It sweeps the pages in ascending order from where the
+ * previous round stopped, so adjacent pages go out in one write and every
+ * dirty page gets its turn.
+ */
+#define FLUSHER_PERIOD_MS 10
+
+/*
+ * The frames' contents are fixed slices of one arena mapped when the pool is
+ * set up, so misses never allocate and the memory of a pool stays what it
+ * was sized for. Arenas of a huge page or more are asked for in huge pages,
+ * which are often not reserved; the arena is then mapped in normal pages and
+ * transparent huge pages are asked for instead. Mappings are page aligned,
+ * as direct I/O needs.
+ *
+ * Past the frames the arena holds up to FLUSH_BATCH bounce pages. Pages are
+ * copied there to be written: the storage manager stamps the checksum into
+ * the buffer it writes from, and clients may pin and read a frame while it
+ * is written back.
+ */
+#define ARENA_HUGE_PAGE ((size_t)2 * 1024 * 1024)
+
+// The pool's write-ahead log is kept next to its page file under this suffix
+#define LOG_SUFFIX ".wal"
+
+/*
+ * Once the log holds this many bytes the pool takes a checkpoint: every
+ * dirty page is written back and the page file synced, after which the log
+ * has nothing left to redo and starts afresh. The flusher checkpoints in the
+ * background; without one, the next unpinPage does. A page still pinned and
+ * dirty keeps the log as it is, the next try comes LOG_CHECKPOINT_RETRY
+ * bytes later.
+ */
+#define LOG_CHECKPOINT_SIZE ((LSN)16 * 1024 * 1024)
+#define LOG_CHECKPOINT_RETRY ((LSN)2 * 1024 * 1024)
+
+/*
+ * Bookkeeping of a buffer pool, stored in BM_BufferPool.mgmtData. Each pool
+ * has its own, so any number of pools can be open at the same time.
+ */
+typedef struct BM_PoolMgmt
+{
+	Frame *frame; // page frames of the pool
+	char *arena;  // contents of the frames, see ARENA_HUGE_PAGE
+	size_t arenaSize;
+	char *bounce;	 // pages being written are copied here, under ioLock
+	int bouncePages; // pages at bounce
+	int buff_size, rear, writeCnt; // writeCnt is changed atomically
+	int loaded;	   // frames holding a page, they are filled from the first one
+	int clockHand; // next frame the CLOCK sweep looks at
+
+	// LRU, ARC and 2Q keep the loaded frames in lists from most to least
+	// recently used: a hit moves its frame to the front and the victim is
+	// taken from the back
+	FrameList queue[2];
+
+	FreqBucket *buckets; // LFU: one bucket per frame and a spare
+	int lowestBucket;	 // LFU: bucket with the lowest count, -1 while empty
+	int freeBucket;		 // LFU: unused buckets, chained through next
+	long lfuPins;		 // LFU: pins since the counts were last halved
+
+	int lrukK, lrukPeriod; // LRU-K: parameters, see BM_LRUKParams
+	long lrukClock;		   // LRU-K: pins of the pool so far
+	long *lrukHist;		   // LRU-K: K reference times per frame, newest first, 0 for none
+
+	Ghost *ghosts;			// ARC and 2Q: remembered pages
+	FrameList ghostQueue[2]; // ARC: B1 and B2, 2Q: A1out
+	int freeGhost;			// unused ghosts, chained through next
+	PageTable ghostTable;	// page number -> ghost index
+	int arcTarget;			// ARC: frames T1 should hold
+	int a1inMax;			// 2Q: frames A1in holds before it gives up pages
+
+	PageShard shards[PAGE_TABLE_SHARDS];
+	pthread_mutex_t replLock; // replacement latch: strategy state, loaded, rear
+	int missedHead;			  // frames hit while replLock was held, -1 if none
+
+	// page file, open for the lifetime of the pool; the file handle is not
+	// thread safe, ioLock serializes the calls on it. Shard latches may be
+	// taken while holding ioLock, to finish the reads of prefetched pages.
+	SM_FileHandle fh;
+	pthread_mutex_t ioLock;
+	int prefetching; // prefetch reads not collected yet, changed atomically
+
+	// Write-ahead log of the pool, not open for in-memory page files
+	WAL_LogHandle wal;
+	LSN lastLsn; // end of the last record logged by markDirty
+	// held shared from logging a change until its frame is marked, and from
+	// clearing a dirty flag until the page is written; a checkpoint holds it
+	// exclusively, so no change is logged or written back meanwhile
+	pthread_rwlock_t logGate;
+	int checkpointing; // a checkpoint is under way, changed atomically
+	LSN checkpointAt;  // log size that triggers the next checkpoint
+
+	// Background flusher, see startPoolFlusher
+	pthread_t flusher;
+	int flusherRunning, flusherStop;
+	double dirtyTarget;		// share of the frames let stay dirty, under flushLock
+	PageNumber flushCursor; // page the next round of the flusher starts at
+	pthread_mutex_t flushLock;
+	pthread_cond_t flushWake; // signalled to stop the flusher
+} BM_PoolMgmt;
+
+#define POOL_MGMT(bm) ((BM_PoolMgmt *)(bm)->mgmtData)
+
+// Function Declarations for Page Replacement Strategy: each returns the
+// unpinned frame to give up for page pageNum, -1 if every frame is pinned
+int FIFO(BM_BufferPool *const, PageNumber);
+int LRU(BM_BufferPool *const, PageNumber);
+int CLOCK(BM_BufferPool *const, PageNumber);
+int LFU(BM_BufferPool *const, PageNumber);
+int LRU_K(BM_BufferPool *const, PageNumber);
+int ARC(BM_BufferPool *const, PageNumber);
+int TWO_Q(BM_BufferPool *const, PageNumber);
+static void arcFirstUse(BM_PoolMgmt *pm, int i, PageNumber oldPage, int vacant);
+static void twoQFirstUse(BM_PoolMgmt *pm, int i, PageNumber oldPage, int vacant);
+
+// Home slot of a page in 2^bits slots: Fibonacci hashing spreads runs of
+// page numbers
+static size_t homeSlot(int bits, PageNumber pgNum)
+{
+	return (size_t)(((uint64_t)pgNum * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static size_t pageSlot(PageTable *table, PageNumber pgNum)
+{
+	return homeSlot((*table).bits, pgNum);
+}
+
+// Make an empty table for up to numEntries pages
+static RC initPageTable(PageTable *table, int numEntries)
+{
+	(*table).bits = 1;
+	while (((size_t)1 << (*table).bits) < (size_t)numEntries * 2)
+		(*table).bits++;
+
+	(*table).count = 0;
+	(*table).retired = NULL;
+	(*table).slots = (PageTableSlot *)malloc(sizeof(PageTableSlot) << (*table).bits);
+	if ((*table).slots == NULL)
+		return RC_MELLOC_MEM_ALLOC_FAILED;
+	for (size_t s = 0; s < ((size_t)1 << (*table).bits); s++)
+		(*table).slots[s].pgNum = NO_PAGE;
+	return RC_OK;
+}
+
+static void insertSlot(PageTable *table, PageNumber pgNum, int frameIdx)
+{
+	PageTableSlot *slots = (*table).slots;
+	size_t mask = ((size_t)1 << (*table).bits) - 1;
+	size_t s = pageSlot(table, pgNum);
+
+	while (slots[s].pgNum != NO_PAGE)
+		s = (s + 1) & mask;
+	__atomic_store_n(&slots[s].frameIdx, frameIdx, __ATOMIC_RELAXED);
+	__atomic_store_n(&slots[s].pgNum, pgNum, __ATOMIC_RELEASE);
+	(*table).count++;
+}
+
+// Double the slots of a table, moving every entry over. The new slots are
+// published before the new size, so a reader that sees the size finds them.
+static RC growPageTable(PageTable *table)
+{
+	PageTable grown;
+	size_t numSlots = (size_t)1 << (*table).bits;
+	RetiredSlots *old = (RetiredSlots *)malloc(sizeof(RetiredSlots));
+
+	if (old == NULL || initPageTable(&grown, (int)numSlots) != RC_OK)
+	{
+		free(old);
+		return RC_MELLOC_MEM_ALLOC_FAILED;
+	}
+	for (size_t s = 0; s < numSlots; s++)
+		if ((*table).slots[s].pgNum != NO_PAGE)
+			insertSlot(&grown, (*table).slots[s].pgNum, (*table).slots[s].frameIdx);
+
+	(*old).slots = (*table).slots;
+	(*old).next = (*table).retired;
+	(*table).retired = old;
+	__atomic_store_n(&(*table).slots, grown.slots, __ATOMIC_RELEASE);
+	__atomic_store_n(&(*table).bits, grown.bits, __ATOMIC_RELEASE);
+	return RC_OK;
+}
+
+static void freePageTable(PageTable *table)
+{
+	while ((*table).retired != NULL)
+	{
+		RetiredSlots *old = (*table).retired;
+		(*table).retired = (*old).next;
+		free((*old).slots);
+		free(old);
+	}
+	free((*table).slots);
+}
+
+// Frame holding the page, NO_PAGE if it is not in the table
+static int findFrame(PageTable *table, PageNumber pgNum)
+{
+	PageTableSlot *slots = (*table).slots;
+	size_t mask = ((size_t)1 << (*table).bits) - 1;
+
+	if (pgNum == NO_PAGE)
+		return NO_PAGE;
+	for (size_t s = pageSlot(table, pgNum);; s = (s + 1) & mask)
+	{
+		if (slots[s].pgNum == pgNum)
+			return slots[s].frameIdx;
+		if (slots[s].pgNum == NO_PAGE)
+			return NO_PAGE;
+	}
+}
+
+// findFrame for a reader holding no latch while the table may change under
+// it: the frame can be stale and a page in the table can be missed, callers
+// check what they get. The size is read before the slots, see growPageTable.
+static int peekFrame(PageTable *table, PageNumber pgNum)
+{
+	int bits = __atomic_load_n(&(*table).bits, __ATOMIC_ACQUIRE);
+	PageTableSlot *slots = __atomic_load_n(&(*table).slots, __ATOMIC_ACQUIRE);
+	size_t mask = ((size_t)1 << bits) - 1;
+	size_t s = homeSlot(bits, pgNum);
+
+	// entries moving back may fill the table for a moment, give up then
+	for (size_t n = 0; n <= mask; n++, s = (s + 1) & mask)
+	{
+		PageNumber slotPage = __atomic_load_n(&slots[s].pgNum, __ATOMIC_ACQUIRE);
+		if (slotPage == pgNum)
+			return __atomic_load_n(&slots[s].frameIdx, __ATOMIC_RELAXED);
+		if (slotPage == NO_PAGE)
+			break;
+	}
+	return NO_PAGE;
+}
+
+// Record that a page not in the table yet is held by frame frameIdx. Fails
+// only when the table is full and cannot grow.
+static RC addFrame(PageTable *table, PageNumber pgNum, int frameIdx)
+{
+	if (((size_t)(*table).count + 1) * 2 > ((size_t)1 << (*table).bits) && growPageTable(table) != RC_OK &&
+		(size_t)(*table).count + 1 >= ((size_t)1 << (*table).bits))
+		return RC_MELLOC_MEM_ALLOC_FAILED;
+	insertSlot(table, pgNum, frameIdx);
+	return RC_OK;
+}
+
+// Forget the frame of a page evicted from the pool
+static void removeFrame(PageTable *table, PageNumber pgNum)
+{
+	PageTableSlot *slots = (*table).slots;
+	size_t mask = ((size_t)1 << (*table).bits) - 1;
+	size_t hole = pageSlot(table, pgNum);
+
+	if (pgNum == NO_PAGE)
+		return;
+	while (slots[hole].pgNum != pgNum)
+	{
+		if (slots[hole].pgNum == NO_PAGE)
+			return;
+		hole = (hole + 1) & mask;
+	}
+	(*table).count--;
+
+	// an entry further down the run moves into the hole unless its home slot
+	// lies between the hole and itself
+	for (size_t s = (hole + 1) & mask; slots[s].pgNum != NO_PAGE; s = (s + 1) & mask)
+	{
+		if (((s - pageSlot(table, slots[s].pgNum)) & mask) >= ((s - hole) & mask))
+		{
+			__atomic_store_n(&slots[hole].frameIdx, slots[s].frameIdx, __ATOMIC_RELAXED);
+			__atomic_store_n(&slots[hole].pgNum, slots[s].pgNum, __ATOMIC_RELEASE);
+			hole = s;
+		}
+	}
+	__atomic_store_n(&slots[hole].pgNum, NO_PAGE, __ATOMIC_RELEASE);
+}
+
+// Put frame i at the front of recency list q
+static void pushRecent(BM_PoolMgmt *pm, int q, int i)
+{
+	Frame *frame = (*pm).frame;
+	FrameList *list = &(*pm).queue[q];
+
+	frame[i].queue = q;
+	frame[i].lruPrev = -1;
+	frame[i].lruNext = (*list).head;
+	if ((*list).head != -1)
+		frame[(*list).head].lruPrev = i;
+	else
+		(*list).tail = i;
+	(*list).head = i;
+	(*list).size++;
+}
+
+static void unlinkRecent(BM_PoolMgmt *pm, int i)
+{
+	Frame *frame = (*pm).frame;
+	FrameList *list = &(*pm).queue[frame[i].queue];
+
+	if (frame[i].lruPrev != -1)
+		frame[frame[i].lruPrev].lruNext = frame[i].lruNext;
+	else
+		(*list).head = frame[i].lruNext;
+	if (frame[i].lruNext != -1)
+		frame[frame[i].lruNext].lruPrev = frame[i].lruPrev;
+	else
+		(*list).tail = frame[i].lruPrev;
+	(*list).size--;
+}
+
+// Frame i was just used
+static void touchRecent(BM_PoolMgmt *pm, int i)
+{
+	int q = (*pm).frame[i].queue;
+
+	if (i != (*pm).queue[q].head)
+	{
+		unlinkRecent(pm, i);
+		pushRecent(pm, q, i);
+	}
+}
+
+// Least recently used frame of list q no client is using, -1 if none
+static int oldestUnpinned(BM_PoolMgmt *pm, int q)
+{
+	Frame *frame = (*pm).frame;
+	int i;
+
+	for (i = (*pm).queue[q].tail; i != -1; i = frame[i].lruPrev)
+	{
+		if (UNPINNED(frame, i))
+			break;
+	}
+	return i;
+}
+
+// Forget remembered page g
+static void dropGhost(BM_PoolMgmt *pm, int g)
+{
+	Ghost *ghosts = (*pm).ghosts;
+	FrameList *list = &(*pm).ghostQueue[ghosts[g].queue];
+
+	if (ghosts[g].prev != -1)
+		ghosts[ghosts[g].prev].next = ghosts[g].next;
+	else
+		(*list).head = ghosts[g].next;
+	if (ghosts[g].next != -1)
+		ghosts[ghosts[g].next].prev = ghosts[g].prev;
+	else
+		(*list).tail = ghosts[g].prev;
+	(*list).size--;
+
+	removeFrame(&(*pm).ghostTable, ghosts[g].pgNum);
+	ghosts[g].next = (*pm).freeGhost;
+	(*pm).freeGhost = g;
+}
+
+// Remember an evicted page at the front of ghost list q. With every ghost in
+// use the oldest one of the list goes, or of the other list if q is empty.
+static void pushGhost(BM_PoolMgmt *pm, int q, PageNumber pgNum)
+{
+	Ghost *ghosts = (*pm).ghosts;
+	FrameList *list = &(*pm).ghostQueue[q];
+
+	if ((*pm).freeGhost == -1)
+		dropGhost(pm, (*list).tail != -1 ? (*list).tail : (*pm).ghostQueue[1 - q].tail);
+
+	int g = (*pm).freeGhost;
+	(*pm).freeGhost = ghosts[g].next;
+	ghosts[g].pgNum = pgNum;
+	ghosts[g].queue = q;
+	ghosts[g].prev = -1;
+	ghosts[g].next = (*list).head;
+	if ((*list).head != -1)
+		ghosts[(*list).head].prev = g;
+	else
+		(*list).tail = g;
+	(*list).head = g;
+	(*list).size++;
+	addFrame(&(*pm).ghostTable, pgNum, g); // never full, it has room for twice the ghosts
+}
+
+// Start LFU with no frame counted and every bucket unused
+static void resetBuckets(BM_PoolMgmt *pm)
+{
+	for (int b = 0; b <= (*pm).buff_size; b++)
+		(*pm).buckets[b].next = b < (*pm).buff_size ? b + 1 : -1;
+	(*pm).freeBucket = 0;
+	(*pm).lowestBucket = -1;
+	(*pm).lfuPins = 0;
+}
+
+// Take an unused bucket for count freq and link it between prev and next
+static int newBucket(BM_PoolMgmt *pm, int freq, int prev, int next)
+{
+	FreqBucket *buckets = (*pm).buckets;
+	int b = (*pm).freeBucket;
+
+	(*pm).freeBucket = buckets[b].next;
+	buckets[b].freq = freq;
+	buckets[b].prev = prev;
+	buckets[b].next = next;
+	buckets[b].head = buckets[b].tail = -1;
+	if (prev != -1)
+		buckets[prev].next = b;
+	else
+		(*pm).lowestBucket = b;
+	if (next != -1)
+		buckets[next].prev = b;
+	return b;
+}
+
+static void appendToBucket(BM_PoolMgmt *pm, int b, int i)
+{
+	Frame *frame = (*pm).frame;
+	FreqBucket *buckets = (*pm).buckets;
+
+	frame[i].bucket = b;
+	frame[i].prevInBucket = buckets[b].tail;
+	frame[i].nextInBucket = -1;
+	if (buckets[b].tail != -1)
+		frame[buckets[b].tail].nextInBucket = i;
+	else
+		buckets[b].head = i;
+	buckets[b].tail = i;
+}
+
+// Take frame i out of its bucket, giving the bucket up once it is empty
+static void removeFromBucket(BM_PoolMgmt *pm, int i)
+{
+	Frame *frame = (*pm).frame;
+	FreqBucket *buckets = (*pm).buckets;
+	int b = frame[i].bucket;
+
+	if (frame[i].prevInBucket != -1)
+		frame[frame[i].prevInBucket].nextInBucket = frame[i].nextInBucket;
+	else
+		buckets[b].head = frame[i].nextInBucket;
+	if (frame[i].nextInBucket != -1)
+		frame[frame[i].nextInBucket].prevInBucket = frame[i].prevInBucket;
+	else
+		buckets[b].tail = frame[i].prevInBucket;
+
+	if (buckets[b].head == -1)
+	{
+		if (buckets[b].prev != -1)
+			buckets[buckets[b].prev].next = buckets[b].next;
+		else
+			(*pm).lowestBucket = buckets[b].next;
+		if (buckets[b].next != -1)
+			buckets[buckets[b].next].prev = buckets[b].prev;
+		buckets[b].next = (*pm).freeBucket;
+		(*pm).freeBucket = b;
+	}
+}
+
+// Halve every count, keeping the frames in their order
+static void ageCounts(BM_PoolMgmt *pm)
+{
+	Frame *frame = (*pm).frame;
+	FreqBucket *buckets = (*pm).buckets;
+	int *order = (int *)malloc(sizeof(int) * (*pm).buff_size);
+	int n = 0, last = -1;
+
+	(*pm).lfuPins = 0;
+	if (order == NULL)
+		return;
+	for (int b = (*pm).lowestBucket; b != -1; b = buckets[b].next)
+		for (int i = buckets[b].head; i != -1; i = frame[i].nextInBucket)
+			order[n++] = i;
+
+	// halving keeps the counts in order, the buckets are rebuilt in one pass
+	resetBuckets(pm);
+	for (int k = 0; k < n; k++)
+	{
+		int i = order[k];
+		frame[i].freq = frame[i].freq > 1 ? frame[i].freq / 2 : 1;
+		if (last == -1 || buckets[last].freq != frame[i].freq)
+			last = newBucket(pm, frame[i].freq, last, -1);
+		appendToBucket(pm, last, i);
+	}
+	free(order);
+}
+
+// A page just loaded into frame i has been used once
+static void countFirstPin(BM_PoolMgmt *pm, int i)
+{
+	int lowest = (*pm).lowestBucket;
+
+	(*pm).frame[i].freq = 1;
+	if (lowest != -1 && (*pm).buckets[lowest].freq == 1)
+		appendToBucket(pm, lowest, i);
+	else
+		appendToBucket(pm, newBucket(pm, 1, -1, lowest), i);
+
+	if (++(*pm).lfuPins > (long)LFU_AGE_PERIOD * (*pm).buff_size)
+		ageCounts(pm);
+}
+
+// A page already in frame i was pinned again
+static void countPin(BM_PoolMgmt *pm, int i)
+{
+	Frame *frame = (*pm).frame;
+	FreqBucket *buckets = (*pm).buckets;
+	int b = frame[i].bucket, next = buckets[b].next;
+	int target = next != -1 && buckets[next].freq == frame[i].freq + 1 ? next : newBucket(pm, frame[i].freq + 1, b, next);
+
+	removeFromBucket(pm, i);
+	frame[i].freq++;
+	appendToBucket(pm, target, i);
+
+	if (++(*pm).lfuPins > (long)LFU_AGE_PERIOD * (*pm).buff_size)
+		ageCounts(pm);
+}
+
+// History of references of frame i
+#define HIST(pm, i) ((*(pm)).lrukHist + (size_t)(i) * (*(pm)).lrukK)
+
+// A page just loaded into frame i is referenced for the first time
+static void firstReference(BM_PoolMgmt *pm, int i)
+{
+	long *hist = HIST(pm, i);
+
+	(*pm).frame[i].lastRef = ++(*pm).lrukClock;
+	hist[0] = (*pm).lrukClock;
+	for (int k = 1; k < (*pm).lrukK; k++)
+		hist[k] = 0;
+}
+
+// A page already in frame i was pinned again
+static void reference(BM_PoolMgmt *pm, int i)
+{
+	Frame *frame = (*pm).frame;
+	long *hist = HIST(pm, i), now = ++(*pm).lrukClock;
+
+	if (now - frame[i].lastRef > (*pm).lrukPeriod)
+	{
+		// a new reference: the older ones move down, shifted by how long
+		// the correlated pins of the previous one lasted
+		long correlated = frame[i].lastRef - hist[0];
+		for (int k = (*pm).lrukK - 1; k > 0; k--)
+			hist[k] = hist[k - 1] ? hist[k - 1] + correlated : 0;
+		hist[0] = now;
+	}
+	frame[i].lastRef = now;
+}
+
+// Open the log of the pool's page file, write back what it holds and start
+// it afresh. Pages of SM_IO_MEMORY files do not survive the process anyway.
+static RC openPoolLog(BM_BufferPool *const bm)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	RC code;
+
+	(*pm).wal.mgmtInfo = NULL;
+	(*pm).lastLsn = 0;
+	(*pm).checkpointAt = LOG_CHECKPOINT_SIZE;
+	if (getIOMode() == SM_IO_MEMORY)
+		return RC_OK;
+
+	char *logName = (char *)malloc(strlen((*bm).pageFile) + strlen(LOG_SUFFIX) + 1);
+	if (logName == NULL)
+		return RC_MELLOC_MEM_ALLOC_FAILED;
+	sprintf(logName, "%s%s", (*bm).pageFile, LOG_SUFFIX);
+
+	if ((code = openLog(logName, &(*pm).wal)) != RC_OK)
+	{
+		free(logName);
+		return code;
+	}
+
+	code = replayLog(&(*pm).wal, &(*pm).fh);
+	if (code == RC_OK)
+		code = truncateLog(&(*pm).wal);
+	if (code != RC_OK)
+	{
+		closeLog(&(*pm).wal);
+		free(logName);
+	}
+	return code;
+}
+
+// Write frame i back to the page file once its log records are durable. The
+// caller holds a pin on the frame, so it keeps its page; a change marked
+// while the write is under way leaves the frame dirty.
+static RC writeFrame(BM_PoolMgmt *pm, int i)
+{
+	Frame *frame = (*pm).frame;
+	RC code = RC_OK;
+
+	pthread_rwlock_rdlock(&(*pm).logGate);
+	LSN lsn = __atomic_load_n(&frame[i].lsn, __ATOMIC_ACQUIRE);
+	__atomic_store_n(&frame[i].dirtyFlag, 0, __ATOMIC_RELEASE);
+	if ((*pm).wal.mgmtInfo != NULL)
+		code = commitLog(&(*pm).wal, lsn);
+	if (code == RC_OK)
+	{
+		pthread_mutex_lock(&(*pm).ioLock);
+		memcpy((*pm).bounce, frame[i].content, (*pm).fh.pageSize);
+		code = ensureCapacity(frame[i].pgNum + 1, &(*pm).fh);
+		if (code == RC_OK)
+			code = writeBlock(frame[i].pgNum, &(*pm).fh, (*pm).bounce);
+		pthread_mutex_unlock(&(*pm).ioLock);
+	}
+
+	if (code != RC_OK)
+		__atomic_store_n(&frame[i].dirtyFlag, DIRTY, __ATOMIC_RELEASE);
+	else
+		__atomic_add_fetch(&(*pm).writeCnt, 1, __ATOMIC_RELAXED); // write operation performed into disk
+	pthread_rwlock_unlock(&(*pm).logGate);
+	return code;
+}
+
+// The read of page pgNum into frame i ended with code, which is returned. A
+// page past the end of the file starts out empty; the file grows to hold it,
+// and any pages before it, once it is written back. The frame stays pinned for the reader if keepPin; pins
+// waiting for the read go on, and fail as well if it did.
+static RC finishLoad(BM_PoolMgmt *pm, int i, PageNumber pgNum, RC code, int keepPin)
+{
+	Frame *frame = (*pm).frame;
+	PageShard *shard = SHARD(pm, pgNum);
+
+	if (code == RC_READ_NON_EXISTING_PAGE)
+	{
+		memset(frame[i].content, 0, (*pm).fh.pageSize);
+		code = RC_OK;
+	}
+
+	pthread_mutex_lock(&(*shard).lock);
+	frame[i].prefetched = 0;
+	if (code != RC_OK)
+	{
+		// the frame is left empty
+		removeFrame(&(*shard).table, pgNum);
+		__atomic_store_n(&frame[i].pgNum, NO_PAGE, __ATOMIC_RELEASE);
+		frame[i].loadError = code;
+	}
+	__atomic_sub_fetch(&frame[i].pin, PIN_LOADING + (code != RC_OK || !keepPin), __ATOMIC_ACQ_REL);
+	pthread_cond_broadcast(&(*shard).loaded);
+	pthread_mutex_unlock(&(*shard).lock);
+	return code;
+}
+
+// Prefetch reads are tagged with their frame
+static int isPrefetchTag(BM_PoolMgmt *pm, void *tag)
+{
+	return (Frame *)tag >= (*pm).frame && (Frame *)tag < (*pm).frame + (*pm).buff_size;
+}
+
+static void finishPrefetch(BM_PoolMgmt *pm, SM_Completion *done)
+{
+	int i = (int)((Frame *)(*done).tag - (*pm).frame);
+
+	finishLoad(pm, i, (*pm).frame[i].pgNum, (*done).rc, 0);
+	__atomic_sub_fetch(&(*pm).prefetching, 1, __ATOMIC_ACQ_REL);
+}
+
+// Collect finished prefetch reads, waiting for minDone of them unless fewer
+// are left. Called with ioLock held: the only transfers in flight then are
+// prefetch reads, everything else is collected before ioLock is let go.
+static int reapPrefetches(BM_PoolMgmt *pm, int minDone)
+{
+	SM_Completion done[FLUSH_BATCH];
+	int n = pollBlockCompletions(&(*pm).fh, done, minDone, FLUSH_BATCH);
+
+	for (int j = 0; j < n; j++)
+		finishPrefetch(pm, &done[j]);
+	return n;
+}
+
+// Map the arena for numFrames frames of pageSize bytes and the bounce pages
+static RC mapArena(BM_PoolMgmt *pm, int numFrames, int pageSize)
+{
+	int bouncePages = numFrames < FLUSH_BATCH ? numFrames : FLUSH_BATCH;
+	size_t size = (size_t)(numFrames + bouncePages) * pageSize;
+	void *arena = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if (size >= ARENA_HUGE_PAGE)
+	{
+		size_t hugeSize = (size + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+		arena = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (arena != MAP_FAILED)
+			size = hugeSize;
+	}
+#endif
+	if (arena == MAP_FAILED)
+	{
+		arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (arena == MAP_FAILED)
+			return RC_MELLOC_MEM_ALLOC_FAILED;
+#ifdef MADV_HUGEPAGE
+		if (size >= ARENA_HUGE_PAGE)
+			madvise(arena, size, MADV_HUGEPAGE);
+#endif
+	}
+
+	(*pm).arena = (char *)arena;
+	(*pm).arenaSize = size;
+	for (int i = 0; i < numFrames; i++)
+		(*pm).frame[i].content = (*pm).arena + (size_t)i * pageSize;
+	(*pm).bounce = (*pm).arena + (size_t)numFrames * pageSize;
+	(*pm).bouncePages = bouncePages;
+	return RC_OK;
+}
+
+// Release the memory of a pool's bookkeeping, whatever part of it was set up
+static void freePoolMgmt(BM_PoolMgmt *pm)
+{
+	if ((*pm).arena != NULL)
+		munmap((*pm).arena, (*pm).arenaSize);
+	for (int s = 0; s < PAGE_TABLE_SHARDS; s++)
+	{
+		freePageTable(&(*pm).shards[s].table);
+		pthread_mutex_destroy(&(*pm).shards[s].lock);
+		pthread_cond_destroy(&(*pm).shards[s].loaded);
+	}
+	pthread_mutex_destroy(&(*pm).replLock);
+	pthread_mutex_destroy(&(*pm).ioLock);
+	pthread_rwlock_destroy(&(*pm).logGate);
+	pthread_mutex_destroy(&(*pm).flushLock);
+	pthread_cond_destroy(&(*pm).flushWake);
+	free((*pm).frame);
+	free((*pm).buckets);
+	free((*pm).lrukHist);
+	free((*pm).ghosts);
+	freePageTable(&(*pm).ghostTable);
+	free(pm);
+}
+
+// Buffer Manager Interface Pool Handling
+RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
+				  const int numPages, ReplacementStrategy strategy,
+				  void *stratData)
+{
+	RC code;
+
+	(*bm).pageFile = (char *)pageFileName; // set name of the file the buffer pool is associated with
+	(*bm).numPages = numPages;			   // Number of pages in the buffer pool
+	(*bm).strategy = strategy;			   // Page Replacement Strategy employed for the buffer pool
+
+	BM_PoolMgmt *pm = (BM_PoolMgmt *)calloc(1, sizeof(BM_PoolMgmt));
+	if (pm == NULL)
+		return RC_MELLOC_MEM_ALLOC_FAILED;
+
+	pthread_mutex_init(&(*pm).replLock, NULL);
+	pthread_mutex_init(&(*pm).ioLock, NULL);
+	pthread_rwlock_init(&(*pm).logGate, NULL);
+	pthread_mutex_init(&(*pm).flushLock, NULL);
+	pthread_cond_init(&(*pm).flushWake, NULL);
+	for (int s = 0; s < PAGE_TABLE_SHARDS; s++)
+	{
+		pthread_mutex_init(&(*pm).shards[s].lock, NULL);
+		pthread_cond_init(&(*pm).shards[s].loaded, NULL);
+	}
+
+	(*pm).frame = calloc(sizeof(Frame), numPages); // Allocate memory for the page Frames in buffer pool
+	if ((*pm).frame == NULL)
+	{
+		freePoolMgmt(pm);
+		return RC_MELLOC_MEM_ALLOC_FAILED;
+	}
+
+	(*pm).buff_size = numPages; // Number of frames in the buffer pool
+	(*pm).rear = -1;			// no page read yet
+	(*pm).missedHead = -1;		// no hit left uncounted
+	Frame *frame = (*pm).frame;
+
+	// Initializing Frame variables
+	int i = 0;
+	while (i < (*pm).buff_size)
+	{
+		frame[i].content = NULL; // set once the page size is known
+		frame[i].pgNum = -1;	 // set every frame to -1, indicating it is vacant
+
+		// Flags
+		frame[i].dirtyFlag = 0; // No modified page present
+		frame[i].pin = 0;		// no pages loaded yet to be used
+		frame[i].refBit = 0;	// CLOCK reference bit cleared
+		i++;
+	}
+
+	for (int q = Q_RECENT; q <= Q_FREQUENT; q++)
+	{
+		(*pm).queue[q].head = (*pm).queue[q].tail = -1;
+		(*pm).ghostQueue[q].head = (*pm).ghostQueue[q].tail = -1;
+	}
+
+	// the shards start out sized for an even spread of the pages and grow
+	for (int s = 0; s < PAGE_TABLE_SHARDS; s++)
+	{
+		if ((code = initPageTable(&(*pm).shards[s].table, numPages / PAGE_TABLE_SHARDS + 1)) != RC_OK)
+		{
+			freePoolMgmt(pm);
+			return code;
+		}
+	}
+
+	if (strategy == RS_LRU_K)
+	{
+		BM_LRUKParams *params = (BM_LRUKParams *)stratData;
+		(*pm).lrukK = params != NULL && (*params).k > 0 ? (*params).k : LRUK_DEFAULT_K;
+		(*pm).lrukPeriod = params != NULL && (*params).correlatedPeriod > 0 ? (*params).correlatedPeriod : 0;
+		if (((*pm).lrukHist = (long *)calloc((size_t)numPages * (*pm).lrukK, sizeof(long))) == NULL)
+		{
+			freePoolMgmt(pm);
+			return RC_MELLOC_MEM_ALLOC_FAILED;
+		}
+	}
+
+	if (strategy == RS_LFU)
+	{
+		if (((*pm).buckets = (FreqBucket *)malloc(sizeof(FreqBucket) * (numPages + 1))) == NULL)
+		{
+			freePoolMgmt(pm);
+			return RC_MELLOC_MEM_ALLOC_FAILED;
+		}
+		resetBuckets(pm);
+	}
+
+	if (strategy == RS_ARC || strategy == RS_2Q)
+	{
+		// ARC remembers as many pages as the pool holds, 2Q half as many
+		int numGhosts = strategy == RS_ARC ? numPages : numPages / TWOQ_OUT_SHARE;
+		if (numGhosts < 1)
+			numGhosts = 1;
+		(*pm).a1inMax = numPages / TWOQ_IN_SHARE > 0 ? numPages / TWOQ_IN_SHARE : 1;
+
+		(*pm).ghosts = (Ghost *)malloc(sizeof(Ghost) * numGhosts);
+		if ((*pm).ghosts == NULL || initPageTable(&(*pm).ghostTable, numGhosts) != RC_OK)
+		{
+			freePoolMgmt(pm);
+			return RC_MELLOC_MEM_ALLOC_FAILED;
+		}
+		for (int g = 0; g < numGhosts; g++)
+			(*pm).ghosts[g].next = g + 1 < numGhosts ? g + 1 : -1;
+		(*pm).freeGhost = 0;
+	}
+
+	// Keep the page file open for the lifetime of the pool
+	if ((code = openPageFile((*bm).pageFile, &(*pm).fh)) != RC_OK)
+	{
+		freePoolMgmt(pm);
+		return code;
+	}
+
+	(*bm).pageSize = (*pm).fh.pageSize; // frames are sized for the file's pages
+	if ((code = mapArena(pm, numPages, (*bm).pageSize)) != RC_OK)
+	{
+		closePageFile(&(*pm).fh);
+		freePoolMgmt(pm);
+		return code;
+	}
+	(*bm).mgmtData = pm;
+
+	// Redo the changes a crash kept from reaching the page file
+	if ((code = openPoolLog(bm)) != RC_OK)
+	{
+		closePageFile(&(*pm).fh);
+		freePoolMgmt(pm);
+		(*bm).mgmtData = NULL;
+		return code;
+	}
+
+	(*pm).writeCnt = 0; // Set number of write operations to 0
+	return RC_OK;
+}
+
+RC shutdownBufferPool(BM_BufferPool *const bm)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	RC code = RC_OK;
+
+	stopPoolFlusher(bm);
+
+	// prefetched pages still on their way hold their frames
+	pthread_mutex_lock(&(*pm).ioLock);
+	while (__atomic_load_n(&(*pm).prefetching, __ATOMIC_ACQUIRE) > 0)
+		reapPrefetches(pm, 1);
+	pthread_mutex_unlock(&(*pm).ioLock);
+
+	// update altered page Frames to page file on disk if dirty
+	if ((code = forceFlushPool(bm)) != RC_OK)
+		return code;
+
+	// Check if there are no pages being utilized by any user
+	for (int i = 0; i < (*pm).buff_size; i++)
+	{
+		if (!UNPINNED(frame, i))
+			return RC_PINNED_PAGES_IN_BUFFER;
+	}
+
+	// Every logged change is in the page file now: once it is synced the log
+	// has nothing left to redo
+	if ((*pm).wal.mgmtInfo != NULL)
+	{
+		if ((*pm).lastLsn > 0 && (code = syncPageFile(&(*pm).fh)) != RC_OK)
+			return code;
+		closeLog(&(*pm).wal);
+		destroyLog((*pm).wal.fileName);
+		free((*pm).wal.fileName);
+	}
+
+	// Release the page file held open since initBufferPool
+	closePageFile(&(*pm).fh);
+
+	freePoolMgmt(pm);
+	(*bm).mgmtData = NULL;
+	return code;
+}
+
+// order frames by the page they hold so adjacent pages can be written together
+static int cmpFramePage(const void *a, const void *b)
+{
+	PageNumber pa = (*(Frame *const *)a)->pgNum, pb = (*(Frame *const *)b)->pgNum;
+	return (pa > pb) - (pa < pb);
+}
+
+static void reverseFrames(Frame **frames, int n)
+{
+	for (int a = 0, b = n - 1; a < b; a++, b--)
+	{
+		Frame *f = frames[a];
+		frames[a] = frames[b];
+		frames[b] = f;
+	}
+}
+
+// Write dirty frames no client is using to the page file, all of them if
+// cursor is NULL. Otherwise at most maxFrames, in ascending page order from
+// *cursor on and wrapping around, and *cursor is moved past the last one.
+static RC writeDirtyFrames(BM_PoolMgmt *pm, int maxFrames, PageNumber *cursor)
+{
+	Frame *frame = (*pm).frame;
+	RC code = RC_OK;
+
+	int buff_size = (*pm).buff_size, numDirty = 0, inflight = 0;
+	SM_Completion done[FLUSH_BATCH];
+	Frame **dirty = (Frame **)malloc(sizeof(Frame *) * buff_size);
+	SM_PageHandle *pages = (SM_PageHandle *)malloc(sizeof(SM_PageHandle) * buff_size);
+	int *runLen = (int *)malloc(sizeof(int) * buff_size);
+
+	if (dirty == NULL || pages == NULL || runLen == NULL)
+	{
+		free(dirty);
+		free(pages);
+		free(runLen);
+		return RC_MELLOC_MEM_ALLOC_FAILED;
+	}
+
+	// Collect modified page Frames (Dirty) that no user is using. Each is
+	// pinned for the write so no miss gives it up meanwhile; misses only give
+	// frames up under the replacement latch.
+	pthread_rwlock_rdlock(&(*pm).logGate);
+	pthread_mutex_lock(&(*pm).replLock);
+	for (int i = 0; i < buff_size; i++)
+	{
+		uint64_t pin = __atomic_load_n(&frame[i].pin, __ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&frame[i].dirtyFlag, __ATOMIC_ACQUIRE) == DIRTY && PIN_COUNT(pin) == 0 &&
+			__atomic_compare_exchange_n(&frame[i].pin, &pin, pin + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			dirty[numDirty++] = &frame[i];
+	}
+	pthread_mutex_unlock(&(*pm).replLock);
+	qsort(dirty, numDirty, sizeof(Frame *), cmpFramePage);
+
+	if (cursor != NULL && numDirty > 0)
+	{
+		// rotate the frames from *cursor on to the front, keep the first ones
+		int start = 0;
+		while (start < numDirty && (*dirty[start]).pgNum < *cursor)
+			start++;
+		reverseFrames(dirty, start);
+		reverseFrames(dirty + start, numDirty - start);
+		reverseFrames(dirty, numDirty);
+		for (; numDirty > maxFrames; numDirty--)
+			__atomic_sub_fetch(&(*dirty[numDirty - 1]).pin, 1, __ATOMIC_ACQ_REL);
+		*cursor = (*dirty[numDirty - 1]).pgNum + 1;
+	}
+
+	// one log sync covers all the pages about to be written
+	LSN lastLsn = __atomic_load_n(&(*pm).lastLsn, __ATOMIC_ACQUIRE);
+	if (numDirty > 0 && (*pm).wal.mgmtInfo != NULL && (code = commitLog(&(*pm).wal, lastLsn)) != RC_OK)
+	{
+		for (int k = 0; k < numDirty; k++)
+			__atomic_sub_fetch(&(*dirty[k]).pin, 1, __ATOMIC_ACQ_REL);
+		numDirty = 0;
+	}
+
+	// a change marked while the page is written leaves it dirty
+	for (int k = 0; k < numDirty; k++)
+		__atomic_store_n(&(*dirty[k]).dirtyFlag, 0, __ATOMIC_RELEASE);
+
+	// The pages go out through the bounce pages, as many at a time as there
+	// are. Each run of adjacent pages is pushed to the page file with one
+	// vectored write; all runs are submitted before waiting so they overlap
+	// on the device.
+	pthread_mutex_lock(&(*pm).ioLock);
+
+	// pages past the end of the file are written once it is grown to hold them
+	PageNumber lastPage = -1;
+	for (int k = 0; k < numDirty; k++)
+		if ((*dirty[k]).pgNum > lastPage)
+			lastPage = (*dirty[k]).pgNum;
+	if (numDirty > 0 && (code = ensureCapacity(lastPage + 1, &(*pm).fh)) != RC_OK)
+	{
+		for (int k = 0; k < numDirty; k++)
+			__atomic_store_n(&(*dirty[k]).dirtyFlag, DIRTY, __ATOMIC_RELEASE);
+		numDirty = 0;
+	}
+
+	for (int wave = 0; wave < numDirty; wave += (*pm).bouncePages)
+	{
+		int end = wave + (*pm).bouncePages < numDirty ? wave + (*pm).bouncePages : numDirty;
+		for (int k = wave; k < end; k++)
+		{
+			pages[k] = (*pm).bounce + (size_t)(k - wave) * (*pm).fh.pageSize;
+			memcpy(pages[k], (*dirty[k]).content, (*pm).fh.pageSize);
+		}
+
+		for (int first = wave; first < end;)
+		{
+			int len = 1;
+			while (first + len < end && (*dirty[first + len]).pgNum == (*dirty[first]).pgNum + len)
+				len++;
+
+			runLen[first] = len;
+			if (writeBlocksAsync((*dirty[first]).pgNum, len, &(*pm).fh, &pages[first], &dirty[first]) == RC_OK)
+				inflight++;
+			else
+			{
+				code = RC_WRITE_FAILED;
+				for (int k = 0; k < len; k++)
+					__atomic_store_n(&(*dirty[first + k]).dirtyFlag, DIRTY, __ATOMIC_RELEASE);
+			}
+			first += len;
+		}
+
+		// Collect the writes before the bounce pages are used again, a
+		// frame is only clean once its page reached the file. Prefetch
+		// reads finishing meanwhile are collected along.
+		while (inflight > 0)
+		{
+			int n = pollBlockCompletions(&(*pm).fh, done, 1, FLUSH_BATCH);
+			for (int j = 0; j < n; j++)
+			{
+				if (isPrefetchTag(pm, done[j].tag))
+				{
+					finishPrefetch(pm, &done[j]);
+					continue;
+				}
+				inflight--;
+
+				Frame **run = (Frame **)done[j].tag;
+				for (int k = 0; k < runLen[run - dirty]; k++)
+				{
+					if (done[j].rc != RC_OK)
+						__atomic_store_n(&(*run[k]).dirtyFlag, DIRTY, __ATOMIC_RELEASE); // still to be written
+					else
+						__atomic_add_fetch(&(*pm).writeCnt, 1, __ATOMIC_RELAXED); // write operation performed into disk
+				}
+				if (done[j].rc != RC_OK)
+					code = done[j].rc;
+			}
+		}
+	}
+	pthread_mutex_unlock(&(*pm).ioLock);
+
+	pthread_rwlock_unlock(&(*pm).logGate);
 
-Frame *frame;	  // declaring frame pointer
-SM_FileHandle fh; // declaring filehandle variable
-RC code;		  // return code handler
+	for (int k = 0; k < numDirty; k++)
+		__atomic_sub_fetch(&(*dirty[k]).pin, 1, __ATOMIC_ACQ_REL);
 
-// Memory allocations to free after shutting down buffer
-Frame *newFrame;
-bool *dirtyFlags;
-PageNumber *frameContents;
-PageNumber *fixCounts;
+	free(dirty);
+	free(pages);
+	free(runLen);
+	return code;
+}
 
-// Function Declarations for Page Replacement Strategy
-RC FIFO(BM_BufferPool *const, Frame *);
-RC LRU(BM_BufferPool *const, Frame *);
+RC forceFlushPool(BM_BufferPool *const bm)
+{
+	return writeDirtyFrames(POOL_MGMT(bm), (*POOL_MGMT(bm)).buff_size, NULL);
+}
 
-// Buffer Manager Interface Pool Handling
-RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
-				  const int numPages, ReplacementStrategy strategy,
-				  void *stratData)
+static int countDirty(BM_PoolMgmt *pm)
 {
-	(*bm).pageFile = (char *)pageFileName; // set name of the file the buffer pool is associated with
-	(*bm).numPages = numPages;			   // Number of pages in the buffer pool
-	(*bm).strategy = strategy;			   // Page Replacement Strategy employed for the buffer pool
+	int numDirty = 0;
 
-	frame = calloc(sizeof(Frame), numPages); // Allocate memory for the page Frames in buffer pool
+	for (int i = 0; i < (*pm).buff_size; i++)
+		if (__atomic_load_n(&(*pm).frame[i].dirtyFlag, __ATOMIC_ACQUIRE) == DIRTY)
+			numDirty++;
+	return numDirty;
+}
 
-	buff_size = numPages; // Number of frames in the buffer pool
+// Take a checkpoint if the log has grown enough, see LOG_CHECKPOINT_SIZE.
+// Dirty frames still pinned by clients are not written, their records stay
+// in the log until a later checkpoint finds the pool clean.
+static RC checkpointPool(BM_PoolMgmt *pm)
+{
+	RC code;
 
-	// Initializing Frame variables
-	int i = 0;
-	while (i < buff_size)
+	if ((*pm).wal.mgmtInfo == NULL ||
+		__atomic_load_n(&(*pm).lastLsn, __ATOMIC_ACQUIRE) < __atomic_load_n(&(*pm).checkpointAt, __ATOMIC_ACQUIRE) ||
+		__atomic_exchange_n(&(*pm).checkpointing, 1, __ATOMIC_ACQ_REL))
+		return RC_OK; // not due yet, or another thread is at it
+
+	code = writeDirtyFrames(pm, (*pm).buff_size, NULL);
+	pthread_rwlock_wrlock(&(*pm).logGate);
+	if (code == RC_OK && countDirty(pm) == 0)
 	{
-		frame[i].content = NULL; // empty content
-		frame[i].pgNum = -1;	 // set every frame to -1, indicating it is vacant
+		pthread_mutex_lock(&(*pm).ioLock);
+		code = syncPageFile(&(*pm).fh);
+		pthread_mutex_unlock(&(*pm).ioLock);
+		if (code == RC_OK)
+			code = truncateLog(&(*pm).wal);
+		if (code == RC_OK)
+			__atomic_store_n(&(*pm).lastLsn, 0, __ATOMIC_RELEASE);
+	}
+	// the log is only empty now if the checkpoint succeeded, a failed one is
+	// tried again once the log has grown some more
+	LSN next = (*pm).lastLsn == 0 ? LOG_CHECKPOINT_SIZE : (*pm).lastLsn + LOG_CHECKPOINT_RETRY;
+	__atomic_store_n(&(*pm).checkpointAt, next, __ATOMIC_RELEASE);
+	pthread_rwlock_unlock(&(*pm).logGate);
 
-		// Flags
-		frame[i].dirtyFlag = 0; // No modified page present
-		frame[i].fixCnt = 0;	// no pages loaded yet to be used
-		frame[i].recentCnt = 0; // LRU flag set to 0
-		i++;
+	__atomic_store_n(&(*pm).checkpointing, 0, __ATOMIC_RELEASE);
+	return code;
+}
+
+// Body of the background flusher thread of a pool
+static void *runFlusher(void *arg)
+{
+	BM_PoolMgmt *pm = (BM_PoolMgmt *)arg;
+
+	pthread_mutex_lock(&(*pm).flushLock);
+	while (!(*pm).flusherStop)
+	{
+		// startPoolFlusher may have changed the target since the last round
+		int target = (int)((*pm).dirtyTarget * (*pm).buff_size);
+		pthread_mutex_unlock(&(*pm).flushLock);
+
+		// a failed write leaves its frame dirty for the next round or the
+		// miss that evicts it, which reports the error
+		int excess = countDirty(pm) - target;
+		while (excess > 0 && !__atomic_load_n(&(*pm).flusherStop, __ATOMIC_ACQUIRE))
+		{
+			writeDirtyFrames(pm, excess < FLUSH_BATCH ? excess : FLUSH_BATCH, &(*pm).flushCursor);
+			excess -= FLUSH_BATCH;
+		}
+		checkpointPool(pm);
+
+		struct timespec wake;
+		clock_gettime(CLOCK_REALTIME, &wake);
+		wake.tv_nsec += FLUSHER_PERIOD_MS * 1000000L;
+		if (wake.tv_nsec >= 1000000000L)
+		{
+			wake.tv_sec++;
+			wake.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock(&(*pm).flushLock);
+		if (!(*pm).flusherStop)
+			pthread_cond_timedwait(&(*pm).flushWake, &(*pm).flushLock, &wake);
 	}
+	pthread_mutex_unlock(&(*pm).flushLock);
+	return NULL;
+}
+
+RC startPoolFlusher(BM_BufferPool *const bm, double dirtyRatio)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+
+	if (dirtyRatio < 0 || dirtyRatio >= 1)
+		return RC_FAILED;
 
-	(*bm).mgmtData = frame;
-	writeCnt = 0; // Set number of write operations to 0
+	pthread_mutex_lock(&(*pm).flushLock);
+	(*pm).dirtyTarget = dirtyRatio;
+	pthread_mutex_unlock(&(*pm).flushLock);
+	if (__atomic_load_n(&(*pm).flusherRunning, __ATOMIC_ACQUIRE))
+		return RC_OK; // the running flusher goes by the new target from its next round on
+
+	(*pm).flusherStop = 0;
+	if (pthread_create(&(*pm).flusher, NULL, runFlusher, pm) != 0)
+		return RC_FAILED;
+	__atomic_store_n(&(*pm).flusherRunning, 1, __ATOMIC_RELEASE);
 	return RC_OK;
 }
 
-RC shutdownBufferPool(BM_BufferPool *const bm)
+RC stopPoolFlusher(BM_BufferPool *const bm)
 {
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
 
-	frame = (Frame *)(*bm).mgmtData;
-	code = RC_OK;
+	if (!(*pm).flusherRunning)
+		return RC_OK;
 
-	// update altered page Frames to page file on disk if dirty
-	if (code = forceFlushPool(bm) != RC_OK)
+	pthread_mutex_lock(&(*pm).flushLock);
+	__atomic_store_n(&(*pm).flusherStop, 1, __ATOMIC_RELEASE);
+	pthread_cond_signal(&(*pm).flushWake);
+	pthread_mutex_unlock(&(*pm).flushLock);
+	pthread_join((*pm).flusher, NULL);
+	__atomic_store_n(&(*pm).flusherRunning, 0, __ATOMIC_RELEASE);
+	return RC_OK;
+}
+
+RC commitPool(BM_BufferPool *const bm)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+
+	// the changes are durable in the log, the pages follow lazily
+	if ((*pm).wal.mgmtInfo == NULL)
+		return RC_OK;
+	return commitLog(&(*pm).wal, __atomic_load_n(&(*pm).lastLsn, __ATOMIC_ACQUIRE));
+}
+
+// Frame holding a page the caller has pinned, so the frame keeps it. Looked
+// up with no latch first; only a miss, which the table changing meanwhile
+// can cause, looks again under the latch of the shard.
+static int pinnedFrame(BM_PoolMgmt *pm, PageNumber pgNum)
+{
+	PageShard *shard = SHARD(pm, pgNum);
+	int i;
+
+	if (pgNum < 0)
+		return NO_PAGE;
+	i = peekFrame(&(*shard).table, pgNum);
+	if (i >= 0 && i < (*pm).buff_size && __atomic_load_n(&(*pm).frame[i].pgNum, __ATOMIC_ACQUIRE) == pgNum)
+		return i;
+	pthread_mutex_lock(&(*shard).lock);
+	i = findFrame(&(*shard).table, pgNum);
+	pthread_mutex_unlock(&(*shard).lock);
+	return i;
+}
+
+// Buffer Manager Interface Access Pages
+RC markDirty(BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	RC code;
+
+	// If the page is in the buffer pool, then set dirtyBit = 1 (page has been modified) for that page
+	int i = pinnedFrame(pm, (*page).pageNum);
+	if (i == NO_PAGE)
+		return RC_FAILED;
+
+	// log the page as it is now, the page file only gets it later. The frame
+	// is marked after its record exists, so a write of the frame under way
+	// meanwhile leaves it dirty.
+	if ((*pm).wal.mgmtInfo == NULL)
+	{
+		__atomic_store_n(&frame[i].dirtyFlag, DIRTY, __ATOMIC_RELEASE);
+		return RC_OK;
+	}
+
+	LSN lsn, last;
+	pthread_rwlock_rdlock(&(*pm).logGate);
+	if ((code = appendLogRecord(&(*pm).wal, &(*pm).fh, frame[i].pgNum, frame[i].content, &lsn)) != RC_OK)
+	{
+		pthread_rwlock_unlock(&(*pm).logGate);
 		return code;
+	}
+	__atomic_store_n(&frame[i].lsn, lsn, __ATOMIC_RELEASE);
+	last = __atomic_load_n(&(*pm).lastLsn, __ATOMIC_ACQUIRE);
+	while (last < lsn && !__atomic_compare_exchange_n(&(*pm).lastLsn, &last, lsn, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		;
+	__atomic_store_n(&frame[i].dirtyFlag, DIRTY, __ATOMIC_RELEASE);
+	pthread_rwlock_unlock(&(*pm).logGate);
+	return RC_OK;
+}
 
-	// Check if there are no pages being utilized by any user
-	for (int i = 0; i < buff_size; i++)
+RC unpinPage(BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+
+	// find requested page Number in the buffer pool
+	int i = pinnedFrame(pm, (*page).pageNum);
+	if (i != NO_PAGE)
 	{
-		if (frame[i].fixCnt != 0)
-			return RC_PINNED_PAGES_IN_BUFFER;
+		// Client no longer is using the page: decrease fix count, an extra
+		// unpin must not borrow from the flags above it
+		uint64_t pin = __atomic_load_n(&frame[i].pin, __ATOMIC_ACQUIRE);
+		while (PIN_COUNT(pin) > 0 &&
+			   !__atomic_compare_exchange_n(&frame[i].pin, &pin, pin - 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			;
 	}
 
-	free(frame);
-	(*bm).mgmtData = NULL;
-	return code;
+	// without a flusher the clients take the checkpoints; a write that
+	// fails leaves its frame dirty for the miss that evicts it to report
+	if (!__atomic_load_n(&(*pm).flusherRunning, __ATOMIC_ACQUIRE))
+		checkpointPool(pm);
+	return RC_OK;
 }
 
-RC forceFlushPool(BM_BufferPool *const bm)
+RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page)
 {
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	PageShard *shard = SHARD(pm, (*page).pageNum);
+	RC code = RC_OK;
+	int i = NO_PAGE;
 
-	frame = (Frame *)(*bm).mgmtData;
-	code = RC_OK;
+	// find requested page Number in the buffer pool and hold it for the write
+	if ((*page).pageNum >= 0)
+	{
+		pthread_mutex_lock(&(*shard).lock);
+		i = findFrame(&(*shard).table, (*page).pageNum);
+		if (i != NO_PAGE)
+			__atomic_add_fetch(&(*pm).frame[i].pin, 1, __ATOMIC_ACQ_REL);
+		pthread_mutex_unlock(&(*shard).lock);
+	}
 
-	// Push contents of modified page Frames (Dirty) to page file on disk
-	for (int i = 0; i < buff_size; i++)
+	if (i != NO_PAGE)
 	{
-		// Check no user is using the page
-		// Check if page Frame has been modified
-		if (frame[i].fixCnt == 0 && frame[i].dirtyFlag == DIRTY)
-		{
-			// Open pageFile on disk
-			openPageFile((*bm).pageFile, &fh);
-			// write contents from page Frame on buffer pool to page File on disk
-			writeBlock(frame[i].pgNum, &fh, frame[i].content);
-			frame[i].dirtyFlag = 0;	 // release dirty flag
-			writeCnt = writeCnt + 1; // write operation performed into disk
-		}
+		// write contents from page Frame on buffer pool to page File on disk
+		code = writeFrame(pm, i);
+		__atomic_sub_fetch(&(*pm).frame[i].pin, 1, __ATOMIC_ACQ_REL);
 	}
 	return code;
 }
 
-// Buffer Manager Interface Access Pages
-RC markDirty(BM_BufferPool *const bm, BM_PageHandle *const page)
+// A page was just given frame i, which held oldPage before unless it was
+// vacant. Update the bookkeeping of the strategy; called under the
+// replacement latch.
+static void firstUse(BM_BufferPool *const bm, int i, PageNumber oldPage, int vacant)
 {
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
 
-	frame = (Frame *)(*bm).mgmtData;
+	if ((*bm).strategy == RS_LFU)
+	{
+		// the new page starts over with a single use
+		if (!vacant)
+			removeFromBucket(pm, i);
+		countFirstPin(pm, i);
+	}
+	else if ((*bm).strategy == RS_LRU_K)
+		firstReference(pm, i); // the history of the evicted page is not kept
+	else if ((*bm).strategy == RS_LRU)
+	{
+		if (vacant)
+			pushRecent(pm, Q_RECENT, i);
+		else
+			touchRecent(pm, i); // the new page is the most recently used
+	}
+	else if ((*bm).strategy == RS_CLOCK && !vacant)
+		(*pm).clockHand = (i + 1) % (*pm).buff_size; // the hand moves on past the victim
+	else if ((*bm).strategy == RS_ARC)
+		arcFirstUse(pm, i, oldPage, vacant);
+	else if ((*bm).strategy == RS_2Q)
+		twoQFirstUse(pm, i, oldPage, vacant);
+}
 
-	int i;
-	for (i = 0; i < buff_size; i++)
+// The strategy counts a pin of the page in frame i, with replLock held
+static void countReference(BM_BufferPool *const bm, int i)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+
+	if ((*bm).strategy == RS_LFU)
+		countPin(pm, i);
+	else if ((*bm).strategy == RS_LRU_K)
+		reference(pm, i);
+	else if ((*bm).strategy == RS_LRU)
+		// LRU algorithm
+		touchRecent(pm, i);
+	else if ((*bm).strategy == RS_ARC)
 	{
-		// If the current page is the page to be marked dirty, then set dirtyBit = 1 (page has been modified) for that page
-		if (frame[i].pgNum == (*page).pageNum)
-		{
-			frame[i].dirtyFlag = DIRTY;
-			return RC_OK;
-		}
+		// used again: the page moves to the front of T2
+		unlinkRecent(pm, i);
+		pushRecent(pm, Q_FREQUENT, i);
 	}
-	return RC_FAILED;
+	else if ((*bm).strategy == RS_2Q && frame[i].queue == Q_FREQUENT)
+		// A1in keeps its order, repeated pins of a new page are one use
+		touchRecent(pm, i);
 }
 
-RC unpinPage(BM_BufferPool *const bm, BM_PageHandle *const page)
+// Count the hits nextUse left on the frames, with replLock held. The list
+// was pushed onto, the frames are counted from the one hit first. A frame
+// is taken off the list before its pins are collected: a hit after that
+// puts it on the list again.
+static void countMissedPins(BM_BufferPool *const bm)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	int i = __atomic_exchange_n(&(*pm).missedHead, -1, __ATOMIC_ACQ_REL), first = -1;
+
+	while (i != -1)
+	{
+		int next = frame[i].nextMissed;
+		frame[i].nextMissed = first;
+		first = i;
+		i = next;
+	}
+	for (i = first; i != -1;)
+	{
+		int next = frame[i].nextMissed;
+		__atomic_store_n(&frame[i].missedQueued, 0, __ATOMIC_SEQ_CST);
+		for (int n = __atomic_exchange_n(&frame[i].missedPins, 0, __ATOMIC_SEQ_CST); n > 0; n--)
+			countReference(bm, i);
+		i = next;
+	}
+}
+
+// The page in frame i was pinned again. A hit never waits for a latch: if
+// another thread holds the replacement latch, the pin is left on the frame
+// and counted by the next thread to take the latch, before the strategy
+// looks for a victim.
+static void nextUse(BM_BufferPool *const bm, int i)
 {
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
 
-	frame = (Frame *)(*bm).mgmtData;
+	if ((*bm).strategy == RS_CLOCK)
+	{
+		__atomic_store_n(&frame[i].refBit, 1, __ATOMIC_RELAXED); // second chance for CLOCK
+		return;
+	}
+	if ((*bm).strategy == RS_FIFO)
+		return;
 
-	int i = 0;
-	while (i < buff_size)
+	if (pthread_mutex_trylock(&(*pm).replLock) != 0)
 	{
-		// find requested page Number in the buffer pool
-		if (frame[i].pgNum == (*page).pageNum)
+		// the frame goes on the list with its first missed pin; it stays
+		// pinned until then, so it holds the same page when it is counted
+		__atomic_add_fetch(&frame[i].missedPins, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_exchange_n(&frame[i].missedQueued, 1, __ATOMIC_SEQ_CST) == 0)
 		{
-			// Client no longer is using the page
-			frame[i].fixCnt = frame[i].fixCnt - 1; // decrease fix count
-			break;
+			int head = __atomic_load_n(&(*pm).missedHead, __ATOMIC_ACQUIRE);
+			do
+				frame[i].nextMissed = head;
+			while (!__atomic_compare_exchange_n(&(*pm).missedHead, &head, i, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
 		}
-		i++;
+		return;
 	}
-	return RC_OK;
+	countMissedPins(bm);
+	countReference(bm, i);
+	pthread_mutex_unlock(&(*pm).replLock);
 }
 
-RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page)
+// Frame to load page pageNum into, pinned and marked loading, or the frame
+// holding the page already if another thread loaded it meanwhile (*loader
+// is 0 then). A dirty victim is written out with no latch held and the
+// choice made again.
+static RC claimFrame(BM_BufferPool *const bm, PageNumber pageNum, int *frameIdx, int *loader)
 {
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	PageShard *shard = SHARD(pm, pageNum);
+	RC code;
 
-	frame = (Frame *)(*bm).mgmtData;
-	code = RC_OK;
-
-	int i;
-	for (i = 0; i < buff_size; i++)
+	for (;;)
 	{
-		// find requested page Number in the buffer pool
-		if (frame[i].pgNum == (*page).pageNum)
+		int victim, vacant = 0;
+		PageNumber oldPage = NO_PAGE;
+		uint64_t pin;
+
+		pthread_mutex_lock(&(*pm).replLock);
+		countMissedPins(bm);
+
+		// pages are only added under the replacement latch, a page not
+		// there now stays away until it is let go
+		pthread_mutex_lock(&(*shard).lock);
+		victim = findFrame(&(*shard).table, pageNum);
+		if (victim != NO_PAGE)
+		{
+			__atomic_add_fetch(&frame[victim].pin, 1, __ATOMIC_ACQ_REL);
+			pthread_mutex_unlock(&(*shard).lock);
+			pthread_mutex_unlock(&(*pm).replLock);
+			*frameIdx = victim;
+			*loader = 0;
+			return RC_OK;
+		}
+		pthread_mutex_unlock(&(*shard).lock);
+
+		if ((*pm).loaded < (*pm).buff_size)
+		{
+			// load the page into the next vacant frame
+			victim = (*pm).loaded++;
+			vacant = 1;
+			__atomic_add_fetch(&frame[victim].pin, PIN_VERSION + PIN_LOADING + 1, __ATOMIC_ACQ_REL);
+		}
+		else
+		{
+			// Call appropriate algorithm's function depending on the page replacement strategy selected (passed through parameters)
+			if ((*bm).strategy == RS_FIFO)
+				victim = FIFO(bm, pageNum);
+			else if ((*bm).strategy == RS_LRU)
+				victim = LRU(bm, pageNum);
+			else if ((*bm).strategy == RS_CLOCK)
+				victim = CLOCK(bm, pageNum);
+			else if ((*bm).strategy == RS_LFU)
+				victim = LFU(bm, pageNum);
+			else if ((*bm).strategy == RS_LRU_K)
+				victim = LRU_K(bm, pageNum);
+			else if ((*bm).strategy == RS_ARC)
+				victim = ARC(bm, pageNum);
+			else if ((*bm).strategy == RS_2Q)
+				victim = TWO_Q(bm, pageNum);
+			else
+			{
+				printf("\n undefined implementation \n");
+				victim = -1;
+			}
+			if (victim == -1)
+			{
+				pthread_mutex_unlock(&(*pm).replLock);
+				return RC_PINNED_PAGES_IN_BUFFER;
+			}
+
+			// a hit may have pinned the victim since the strategy looked
+			oldPage = frame[victim].pgNum;
+			PageShard *oldShard = oldPage != NO_PAGE ? SHARD(pm, oldPage) : NULL;
+			if (oldShard != NULL)
+				pthread_mutex_lock(&(*oldShard).lock);
+			pin = __atomic_load_n(&frame[victim].pin, __ATOMIC_ACQUIRE);
+			if (PIN_COUNT(pin) != 0)
+			{
+				if (oldShard != NULL)
+					pthread_mutex_unlock(&(*oldShard).lock);
+				pthread_mutex_unlock(&(*pm).replLock);
+				continue;
+			}
+
+			// move contents from page frame to page file if they were altered
+			if (oldShard != NULL && __atomic_load_n(&frame[victim].dirtyFlag, __ATOMIC_ACQUIRE) == DIRTY)
+			{
+				__atomic_add_fetch(&frame[victim].pin, 1, __ATOMIC_ACQ_REL);
+				pthread_mutex_unlock(&(*oldShard).lock);
+				pthread_mutex_unlock(&(*pm).replLock);
+				code = writeFrame(pm, victim);
+				__atomic_sub_fetch(&frame[victim].pin, 1, __ATOMIC_ACQ_REL);
+				if (code != RC_OK)
+					return code;
+				continue;
+			}
+
+			// taking the frame fails if a hit pinned it with no latch since
+			if (!__atomic_compare_exchange_n(&frame[victim].pin, &pin, pin + PIN_VERSION + PIN_LOADING + 1, 0,
+											 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			{
+				if (oldShard != NULL)
+					pthread_mutex_unlock(&(*oldShard).lock);
+				pthread_mutex_unlock(&(*pm).replLock);
+				continue;
+			}
+			if (oldShard != NULL)
+			{
+				removeFrame(&(*oldShard).table, oldPage);
+				pthread_mutex_unlock(&(*oldShard).lock);
+			}
+		}
+
+		// the frame holds the new page from now on, it is read in later;
+		// it is pinned and loading since it was taken
+		__atomic_store_n(&frame[victim].pgNum, pageNum, __ATOMIC_RELEASE);
+		frame[victim].refBit = 1;
+		frame[victim].loadError = RC_OK;
+		__atomic_store_n(&frame[victim].missedPins, 0, __ATOMIC_SEQ_CST); // hits of the old page
+		(*pm).rear++;
+		firstUse(bm, victim, oldPage, vacant);
+
+		pthread_mutex_lock(&(*shard).lock);
+		code = addFrame(&(*shard).table, pageNum, victim);
+		pthread_mutex_unlock(&(*shard).lock);
+		if (code != RC_OK)
 		{
-			// Open pageFile on disk
-			if (code = openPageFile((*bm).pageFile, &fh) != RC_OK)
-				return code;
-			// write contents from page Frame on buffer pool to page File on disk
-			if (code = writeBlock(frame[i].pgNum, &fh, frame[i].content) != RC_OK)
-				return code;
-
-			frame[i].dirtyFlag = 0; // modified frame already written into disk
-			writeCnt = writeCnt + 1;
+			// left holding no page, the strategy gives the frame up first
+			__atomic_store_n(&frame[victim].pgNum, NO_PAGE, __ATOMIC_RELEASE);
+			__atomic_sub_fetch(&frame[victim].pin, PIN_LOADING + 1, __ATOMIC_ACQ_REL);
+			pthread_mutex_unlock(&(*pm).replLock);
+			return code;
 		}
+		pthread_mutex_unlock(&(*pm).replLock);
+
+		*frameIdx = victim;
+		*loader = 1;
+		return RC_OK;
 	}
-	return code;
+}
+
+// Pin frame i with no latch held if it holds page pgNum, read in. The page
+// number is read after the pin word it is checked against, and the swap
+// fails if the frame changed hands or started loading since.
+static int tryPin(BM_PoolMgmt *pm, int i, PageNumber pgNum)
+{
+	Frame *frame = (*pm).frame;
+	uint64_t pin;
+
+	if (i < 0 || i >= (*pm).buff_size)
+		return 0;
+	pin = __atomic_load_n(&frame[i].pin, __ATOMIC_ACQUIRE);
+	do
+	{
+		if ((pin & PIN_LOADING) || __atomic_load_n(&frame[i].pgNum, __ATOMIC_ACQUIRE) != pgNum)
+			return 0;
+	} while (!__atomic_compare_exchange_n(&frame[i].pin, &pin, pin + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	return 1;
 }
 
 RC pinPage(BM_BufferPool *const bm, BM_PageHandle *const page,
 		   const PageNumber pageNum)
 {
-	frame = (Frame *)(*bm).mgmtData;
-	code = RC_OK;
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	PageShard *shard = SHARD(pm, pageNum);
+	RC code = RC_OK;
+	int i, loader = 0;
+
+	if (pageNum < 0)
+		return RC_READ_NON_EXISTING_PAGE;
+
+	// page already in the buffer pool and read in: pinned with no latch
+	i = peekFrame(&(*shard).table, pageNum);
+	if (i != NO_PAGE && tryPin(pm, i, pageNum))
+	{
+		nextUse(bm, i);
+		(*page).pageNum = pageNum;
+		(*page).data = frame[i].content;
+		return RC_OK;
+	}
+
+	// otherwise looked up again under the latch of its shard
+	pthread_mutex_lock(&(*shard).lock);
+	i = findFrame(&(*shard).table, pageNum);
+	if (i != NO_PAGE)
+		__atomic_add_fetch(&frame[i].pin, 1, __ATOMIC_ACQ_REL);
+	pthread_mutex_unlock(&(*shard).lock);
 
-	// Check if 1st page frame is vacant
-	if (frame[0].pgNum == NO_PAGE)
+	if (i != NO_PAGE)
+		nextUse(bm, i);
+	else
 	{
-		// Opening page File on disk
-		if (code = openPageFile((*bm).pageFile, &fh) != RC_OK)
+		// frames of prefetched pages are held until their reads are collected
+		while ((code = claimFrame(bm, pageNum, &i, &loader)) == RC_PINNED_PAGES_IN_BUFFER &&
+			   __atomic_load_n(&(*pm).prefetching, __ATOMIC_ACQUIRE) > 0)
+		{
+			pthread_mutex_lock(&(*pm).ioLock);
+			reapPrefetches(pm, 1);
+			pthread_mutex_unlock(&(*pm).ioLock);
+		}
+		if (code != RC_OK)
 			return code;
-		// Allocating space for the page Frame in the Buffer Pool
-		frame[0].content = (SM_PageHandle)malloc(PAGE_SIZE);
+	}
+
+	if (loader)
+	{
 		// Reading contents from page File in disk and load it in page Frame of Buffer Pool
-		if (code = readBlock(pageNum, &fh, frame[0].content) != RC_OK)
+		pthread_mutex_lock(&(*pm).ioLock);
+		code = readBlock(pageNum, &(*pm).fh, frame[i].content);
+		if (__atomic_load_n(&(*pm).prefetching, __ATOMIC_ACQUIRE) > 0)
+			reapPrefetches(pm, 0);
+		pthread_mutex_unlock(&(*pm).ioLock);
+
+		if ((code = finishLoad(pm, i, pageNum, code, 1)) != RC_OK)
 			return code;
-		// set the page Frame number to the page File number in the disk
-		frame[0].pgNum = pageNum;
-		frame[0].fixCnt++;
-		// Init LRU params
-		rear = hit = 0;
-		frame[0].recentCnt = hit;
-		(*page).pageNum = pageNum;
-		(*page).data = frame[0].content;
-		return code;
 	}
 	else
 	{
-		int i;
-		bool isBufferFull = true;
-
-		for (i = 0; i < buff_size; i++)
+		// another thread may still be reading the page in; the read of a
+		// prefetched page has no thread waiting for it, the pin collects it
+		pthread_mutex_lock(&(*shard).lock);
+		while (__atomic_load_n(&frame[i].pin, __ATOMIC_ACQUIRE) & PIN_LOADING)
 		{
-			if (frame[i].pgNum != NO_PAGE)
-			{
-				if (frame[i].pgNum == pageNum)
-				{
-					frame[i].fixCnt++;
-					isBufferFull = false;
-					hit++;
-
-					if ((*bm).strategy == RS_LRU)
-						// LRU algorithm
-						frame[i].recentCnt = hit;
-					(*page).pageNum = pageNum;
-					(*page).data = frame[i].content;
-					break;
-				}
-			}
-			else
+			if (!frame[i].prefetched)
 			{
-
-				openPageFile((*bm).pageFile, &fh);
-				frame[i].content = (SM_PageHandle)malloc(PAGE_SIZE);
-				readBlock(pageNum, &fh, frame[i].content);
-				frame[i].pgNum = pageNum;
-				frame[i].fixCnt = 1;
-				rear++;
-				hit++;
-
-				if ((*bm).strategy == RS_LRU)
-					frame[i].recentCnt = hit;
-
-				(*page).pageNum = pageNum;
-				(*page).data = frame[i].content;
-
-				isBufferFull = false;
-				break;
+				pthread_cond_wait(&(*shard).loaded, &(*shard).lock);
+				continue;
 			}
+			pthread_mutex_unlock(&(*shard).lock);
+			pthread_mutex_lock(&(*pm).ioLock);
+			if (__atomic_load_n(&frame[i].pin, __ATOMIC_ACQUIRE) & PIN_LOADING)
+				reapPrefetches(pm, 1);
+			pthread_mutex_unlock(&(*pm).ioLock);
+			pthread_mutex_lock(&(*shard).lock);
 		}
-
-		if (isBufferFull)
+		if (frame[i].pgNum != pageNum)
 		{
-			// Create a new page to store data read from the file.
-			newFrame = (Frame *)malloc(sizeof(Frame));
+			code = frame[i].loadError;
+			__atomic_sub_fetch(&frame[i].pin, 1, __ATOMIC_ACQ_REL);
+		}
+		pthread_mutex_unlock(&(*shard).lock);
+		if (code != RC_OK)
+			return code;
+	}
 
-			// Reading page from disk and initializing page frame's content in the buffer pool
-			openPageFile((*bm).pageFile, &fh);
-			(*newFrame).content = (SM_PageHandle)malloc(PAGE_SIZE);
-			readBlock(pageNum, &fh, (*newFrame).content);
-			(*newFrame).pgNum = pageNum;
-			(*newFrame).dirtyFlag = 0;
-			(*newFrame).fixCnt = 1;
-			rear++;
-			hit++;
+	(*page).pageNum = pageNum;
+	(*page).data = frame[i].content;
+	return RC_OK;
+}
 
-			if ((*bm).strategy == RS_LRU)
-				(*newFrame).recentCnt = hit;
+RC prefetchPages(BM_BufferPool *const bm, const PageNumber *pageNums, int count)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	RC code = RC_OK;
 
-			(*page).pageNum = pageNum;
-			(*page).data = (*newFrame).content;
+	// make room by collecting the prefetches that finished already
+	if (__atomic_load_n(&(*pm).prefetching, __ATOMIC_ACQUIRE) > 0)
+	{
+		pthread_mutex_lock(&(*pm).ioLock);
+		reapPrefetches(pm, 0);
+		pthread_mutex_unlock(&(*pm).ioLock);
+	}
 
-			// Call appropriate algorithm's function depending on the page replacement strategy selected (passed through parameters)
+	for (int k = 0; k < count; k++)
+	{
+		PageNumber pageNum = pageNums[k];
+		int i, loader;
 
-			// Using FIFO algorithm
-			if ((*bm).strategy == RS_FIFO)
-			{
-				code = FIFO(bm, newFrame);
-				if (code != RC_OK)
-					return code;
-			}
-			// Using LRU algorithm
-			else if ((*bm).strategy == RS_LRU)
-			{
+		if (pageNum < 0 || peekFrame(&SHARD(pm, pageNum)->table, pageNum) != NO_PAGE)
+			continue;
 
-				code = LRU(bm, newFrame);
-				if (code != RC_OK)
-					return code;
-			}
-			else
-				printf("\n undefined implementation \n");
+		// the frame is claimed like for a miss but not kept pinned once read
+		// in; with every frame in use the remaining pages are left to pinPage
+		code = claimFrame(bm, pageNum, &i, &loader);
+		if (code == RC_PINNED_PAGES_IN_BUFFER)
+			return RC_OK;
+		if (code != RC_OK)
+			return code;
+		if (!loader)
+		{
+			__atomic_sub_fetch(&frame[i].pin, 1, __ATOMIC_ACQ_REL);
+			continue;
 		}
-		return code;
+
+		// the frame is marked prefetched only once its read is in flight, pins
+		// waiting on it meanwhile are woken up to collect it
+		pthread_mutex_lock(&(*pm).ioLock);
+		code = readBlockAsync(pageNum, &(*pm).fh, frame[i].content, &frame[i]);
+		if (code == RC_OK)
+		{
+			PageShard *shard = SHARD(pm, pageNum);
+			__atomic_add_fetch(&(*pm).prefetching, 1, __ATOMIC_ACQ_REL);
+			pthread_mutex_lock(&(*shard).lock);
+			frame[i].prefetched = 1;
+			pthread_cond_broadcast(&(*shard).loaded);
+			pthread_mutex_unlock(&(*shard).lock);
+		}
+		pthread_mutex_unlock(&(*pm).ioLock);
+
+		// a page past the end of the file is ready right away
+		if (code != RC_OK && (code = finishLoad(pm, i, pageNum, code, 0)) != RC_OK)
+			return code;
 	}
+	return RC_OK;
 }
 
 // Statistics Interface
 PageNumber *getFrameContents(BM_BufferPool *const bm)
 {
-	frameContents = calloc(sizeof(PageNumber), buff_size);
-	frame = (Frame *)(*bm).mgmtData;
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	PageNumber *frameContents = calloc(sizeof(PageNumber), (*pm).buff_size);
+	Frame *frame = (*pm).frame;
 	// Iterating through all the pages in the buffer pool and setting frameContents' value to pageNum of the page
-	for (int i = 0; i < buff_size; i++)
+	for (int i = 0; i < (*pm).buff_size; i++)
 	{
 
 		if (frame[i].pgNum != NO_PAGE)
@@ -318,14 +1953,14 @@ PageNumber *getFrameContents(BM_BufferPool *const bm)
 
 bool *getDirtyFlags(BM_BufferPool *const bm)
 {
-
-	dirtyFlags = calloc(sizeof(bool), buff_size);
-	frame = (Frame *)(*bm).mgmtData;
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	bool *dirtyFlags = calloc(sizeof(bool), (*pm).buff_size);
+	Frame *frame = (*pm).frame;
 
 	int i;
-	for (i = 0; i < buff_size; i++)
+	for (i = 0; i < (*pm).buff_size; i++)
 	{
-		if (frame[i].dirtyFlag == DIRTY)
+		if (__atomic_load_n(&frame[i].dirtyFlag, __ATOMIC_ACQUIRE) == DIRTY) // the flusher may be writing
 			dirtyFlags[i] = true;
 		else
 			dirtyFlags[i] = false;
@@ -335,27 +1970,25 @@ bool *getDirtyFlags(BM_BufferPool *const bm)
 
 int *getFixCounts(BM_BufferPool *const bm)
 {
-	fixCounts = calloc(sizeof(int), buff_size);
-	frame = (Frame *)(*bm).mgmtData;
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	int *fixCounts = calloc(sizeof(int), (*pm).buff_size);
+	Frame *frame = (*pm).frame;
 
 	int i = 0;
-	while (i < buff_size)
+	while (i < (*pm).buff_size)
 	{
-		if (frame[i].fixCnt != -1)
-			fixCounts[i] = frame[i].fixCnt;
-		else
-			fixCounts[i] = 0;
+		fixCounts[i] = FIX_COUNT(frame, i);
 		i++;
 	}
 	return fixCounts;
 }
 int getNumReadIO(BM_BufferPool *const bm)
 {
-	return rear + 1;
+	return POOL_MGMT(bm)->rear + 1;
 }
 int getNumWriteIO(BM_BufferPool *const bm)
 {
-	return writeCnt;
+	return __atomic_load_n(&POOL_MGMT(bm)->writeCnt, __ATOMIC_RELAXED);
 }
 
 /*
@@ -367,39 +2000,21 @@ int getNumWriteIO(BM_BufferPool *const bm)
 */
 
 // Implementing First-In-First-Out page replacement strategy
-RC FIFO(BM_BufferPool *const bm, Frame *page)
+int FIFO(BM_BufferPool *const bm, PageNumber pageNum)
 {
-	// initializing empty frame
-	frame = (Frame *)(*bm).mgmtData;
-	code = RC_OK;
+	(void)pageNum; // only ARC looks at the page to be loaded
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	int buff_size = (*pm).buff_size;
 
-	int front = rear % buff_size;
+	// frames are given up in turn, starting after the one loaded last
+	int front = ((*pm).rear + 1) % buff_size;
 	// iterating through every page frame in the buffer pool
 	for (int i = 0; i < buff_size; i++)
 	{
 		// check if page can be evicted
-		if (frame[front].fixCnt == 0)
-		{
-			// check if page frame content has been altered
-			if (frame[front].dirtyFlag == DIRTY)
-			{
-				// move contents from page frame to page file
-				if (code = openPageFile((*bm).pageFile, &fh) != RC_OK)
-					return code;
-
-				if (code = writeBlock(frame[front].pgNum, &fh, frame[front].content) != RC_OK)
-					return code;
-				// record write operation
-				writeCnt++;
-			}
-
-			// loading content from page file to page frame
-			frame[front].content = (*page).content;		// load content
-			frame[front].pgNum = (*page).pgNum;			// page number being loaded from disk
-			frame[front].dirtyFlag = (*page).dirtyFlag; // Initialize dirtFlag to 0
-			frame[front].fixCnt = (*page).fixCnt;		// setting fixCnt to 0
-			break;
-		}
+		if (UNPINNED(frame, front))
+			return front;
 
 		front++;
 
@@ -407,53 +2022,194 @@ RC FIFO(BM_BufferPool *const bm, Frame *page)
 		if (front % buff_size == 0)
 			front = 0;
 	}
-
-	return code;
+	return -1;
 }
 
 // Implementing Least Recently Used page replacement strategy
-RC LRU(BM_BufferPool *const bm, Frame *page)
+int LRU(BM_BufferPool *const bm, PageNumber pageNum)
+{
+	(void)pageNum;
+	// Finding the least recently used page frame that no client is using
+	return oldestUnpinned(POOL_MGMT(bm), Q_RECENT);
+}
+
+// Implementing CLOCK (second chance) page replacement strategy
+int CLOCK(BM_BufferPool *const bm, PageNumber pageNum)
+{
+	(void)pageNum;
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+
+	// The hand sweeps the frames in a circle, clearing reference bits, and
+	// stops at the first unpinned frame whose bit is already clear. Two full
+	// turns clear every bit, so a frame is found unless all are pinned. The
+	// hand stays on the victim until its frame is given up.
+	for (int step = 0; step < 2 * (*pm).buff_size; step++)
+	{
+		int victim = (*pm).clockHand;
+
+		if (UNPINNED(frame, victim) && !__atomic_exchange_n(&frame[victim].refBit, 0, __ATOMIC_RELAXED))
+			return victim;
+		(*pm).clockHand = ((*pm).clockHand + 1) % (*pm).buff_size;
+	}
+	return -1;
+}
+
+// Implementing Least Frequently Used page replacement strategy
+int LFU(BM_BufferPool *const bm, PageNumber pageNum)
 {
-	frame = (Frame *)bm->mgmtData;
-	int i, least_recent_index, least_recent_count;
-	code = RC_OK;
+	(void)pageNum;
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	FreqBucket *buckets = (*pm).buckets;
 
-	for (i = 0; i < buff_size; i++)
+	// oldest unpinned frame among those with the lowest count
+	for (int b = (*pm).lowestBucket; b != -1; b = buckets[b].next)
 	{
-		if (frame[i].fixCnt == 0)
+		for (int i = buckets[b].head; i != -1; i = frame[i].nextInBucket)
 		{
-			least_recent_index = i;
-			least_recent_count = frame[i].recentCnt;
-			break;
+			if (UNPINNED(frame, i))
+				return i;
 		}
 	}
+	return -1;
+}
 
-	// Finding the page frame having minimum recentCnt
-	for (i = least_recent_index + 1; i < buff_size; i++)
+// Implementing LRU-K page replacement strategy
+int LRU_K(BM_BufferPool *const bm, PageNumber pageNum)
+{
+	(void)pageNum;
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	Frame *frame = (*pm).frame;
+	int lrukK = (*pm).lrukK;
+
+	// Unpinned frame with the oldest K-th reference (0 when there is none),
+	// the oldest last reference breaking ties. Frames within their
+	// correlated period only qualify when no other frame does.
+	int victim = -1, victimCorrelated = 1;
+	long now = (*pm).lrukClock + 1;
+	for (int i = 0; i < (*pm).buff_size; i++)
 	{
-		if (frame[i].recentCnt < least_recent_count)
+		if (!UNPINNED(frame, i))
+			continue;
+
+		int correlated = now - frame[i].lastRef <= (*pm).lrukPeriod;
+		long *hist = HIST(pm, i), *best = victim != -1 ? HIST(pm, victim) : NULL;
+		if (victim == -1 || correlated < victimCorrelated ||
+			(correlated == victimCorrelated && (hist[lrukK - 1] < best[lrukK - 1] ||
+												(hist[lrukK - 1] == best[lrukK - 1] && hist[0] < best[0]))))
 		{
-			least_recent_index = i;
-			least_recent_count = frame[i].recentCnt;
+			victim = i;
+			victimCorrelated = correlated;
 		}
 	}
+	return victim;
+}
+
+// Target size of T1 once page pageNum is loaded: a miss on a page evicted
+// lately from T1 means T1 was too small, one evicted from T2 that T2 was.
+// The target moves faster the smaller the ghost list that was hit is
+// compared to the other. *g is the ghost of the page, NO_PAGE if none.
+static int arcTarget(BM_PoolMgmt *pm, PageNumber pageNum, int *g)
+{
+	FrameList *b1 = &(*pm).ghostQueue[Q_RECENT], *b2 = &(*pm).ghostQueue[Q_FREQUENT];
+	int target = (*pm).arcTarget;
+
+	*g = findFrame(&(*pm).ghostTable, pageNum);
+	if (*g != NO_PAGE && (*pm).ghosts[*g].queue == Q_RECENT)
+		target += (*b2).size > (*b1).size ? (*b2).size / (*b1).size : 1;
+	else if (*g != NO_PAGE)
+		target -= (*b1).size > (*b2).size ? (*b1).size / (*b2).size : 1;
+	return target < 0 ? 0 : target > (*pm).buff_size ? (*pm).buff_size : target;
+}
+
+// Implementing Adaptive Replacement Cache page replacement strategy
+int ARC(BM_BufferPool *const bm, PageNumber pageNum)
+{
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+	int g, target = arcTarget(pm, pageNum, &g);
+	int t1 = (*pm).queue[Q_RECENT].size;
+
+	// T1 gives up its least recent page while it is above its target, T2
+	// otherwise; when all of a list's pages are pinned the other one does
+	int fromT1 = t1 > 0 && (t1 > target || (g != NO_PAGE && (*pm).ghosts[g].queue == Q_FREQUENT && t1 == target));
+	int victim = oldestUnpinned(pm, fromT1 ? Q_RECENT : Q_FREQUENT);
+	if (victim == -1)
+		victim = oldestUnpinned(pm, fromT1 ? Q_FREQUENT : Q_RECENT);
+	return victim;
+}
+
+// ARC bookkeeping for frame i, just given a new page in place of oldPage
+static void arcFirstUse(BM_PoolMgmt *pm, int i, PageNumber oldPage, int vacant)
+{
+	FrameList *t1 = &(*pm).queue[Q_RECENT], *b1 = &(*pm).ghostQueue[Q_RECENT];
+	FrameList *b2 = &(*pm).ghostQueue[Q_FREQUENT];
+	int c = (*pm).buff_size, g, remember = 1;
+	int victimQueue = (*pm).frame[i].queue;
 
-	if (frame[least_recent_index].dirtyFlag == 1)
+	if (vacant)
 	{
-		SM_FileHandle fh;
-		if (code = openPageFile(bm->pageFile, &fh) != RC_OK)
-			return code;
-		if (code = writeBlock(frame[least_recent_index].pgNum, &fh, frame[least_recent_index].content))
-			return code;
+		pushRecent(pm, Q_RECENT, i);
+		return;
+	}
+	(*pm).arcTarget = arcTarget(pm, (*pm).frame[i].pgNum, &g);
+	unlinkRecent(pm, i);
+
+	// T1 and B1 together hold at most c pages and all four lists 2c, so
+	// the ghosts at most c: a new page makes room in the ghost lists first.
+	// With B1 empty T1 held all c frames and its victim is not remembered.
+	if (g != NO_PAGE)
+		dropGhost(pm, g);
+	else if ((*t1).size + (victimQueue == Q_RECENT) + (*b1).size >= c)
+	{
+		if ((*b1).size > 0)
+			dropGhost(pm, (*b1).tail);
+		else
+			remember = 0;
+	}
+	else if ((*b1).size + (*b2).size >= c && (*b2).size > 0)
+		dropGhost(pm, (*b2).tail);
+
+	if (remember && oldPage != NO_PAGE)
+		pushGhost(pm, victimQueue, oldPage);
 
-		// Increase the writeCount which records the number of writes done by the buffer manager.
-		writeCnt++;
+	// a page back from a ghost list has been used twice
+	pushRecent(pm, g != NO_PAGE ? Q_FREQUENT : Q_RECENT, i);
+}
+
+// Implementing 2Q page replacement strategy
+int TWO_Q(BM_BufferPool *const bm, PageNumber pageNum)
+{
+	(void)pageNum;
+	BM_PoolMgmt *pm = POOL_MGMT(bm);
+
+	// A1in gives up its oldest page once it holds more than its share, Am its
+	// least recently used one otherwise; when all of a list's pages are
+	// pinned the other one does
+	int fromA1in = (*pm).queue[Q_RECENT].size > (*pm).a1inMax;
+	int victim = oldestUnpinned(pm, fromA1in ? Q_RECENT : Q_FREQUENT);
+	if (victim == -1)
+		victim = oldestUnpinned(pm, fromA1in ? Q_FREQUENT : Q_RECENT);
+	return victim;
+}
+
+// 2Q bookkeeping for frame i, just given a new page in place of oldPage
+static void twoQFirstUse(BM_PoolMgmt *pm, int i, PageNumber oldPage, int vacant)
+{
+	int g = NO_PAGE;
+
+	if (!vacant)
+	{
+		// A1out remembers the pages out of A1in, dropping its oldest when full
+		int victimQueue = (*pm).frame[i].queue;
+		unlinkRecent(pm, i);
+		g = findFrame(&(*pm).ghostTable, (*pm).frame[i].pgNum);
+		if (g != NO_PAGE)
+			dropGhost(pm, g);
+		if (victimQueue == Q_RECENT && oldPage != NO_PAGE)
+			pushGhost(pm, Q_RECENT, oldPage);
 	}
 
-	// Setting page frame's content to new page's content
-	frame[least_recent_index].content = page->content;
-	frame[least_recent_index].pgNum = page->pgNum;
-	frame[least_recent_index].dirtyFlag = page->dirtyFlag;
-	frame[least_recent_index].fixCnt = page->fixCnt;
-	frame[least_recent_index].recentCnt = page->recentCnt;
+	// a page seen again after leaving A1in goes to Am, a new one into A1in
+	pushRecent(pm, g != NO_PAGE ? Q_FREQUENT : Q_RECENT, i);
 }
@@ -13,20 +13,30 @@ typedef enum ReplacementStrategy {
   RS_LRU = 1,
   RS_CLOCK = 2,
   RS_LFU = 3,
-  RS_LRU_K = 4
+  RS_LRU_K = 4,
+  RS_ARC = 5, // adaptive replacement cache, balances recency and frequency
+  RS_2Q = 6   // new pages wait in a FIFO before they compete with hot ones
 } ReplacementStrategy;
 
 // Data Types and Structures
-typedef int PageNumber;
 #define NO_PAGE -1
 #define DIRTY 1
 
+// stratData of an RS_LRU_K pool; NULL gives K = 2 without a correlation period
+typedef struct BM_LRUKParams {
+  int k;                // references remembered per page
+  int correlatedPeriod; // repeated pins of a page within this many pins of the
+                        // pool count as a single reference
+} BM_LRUKParams;
+
 typedef struct BM_BufferPool {
   char *pageFile;
   int numPages;
+  int pageSize; // page size of pageFile, set by initBufferPool
   ReplacementStrategy strategy;
   void *mgmtData; // use this one to store the bookkeeping info your buffer 
-                  // manager needs for a buffer pool
+                  // manager needs for a buffer pool; every pool has its own,
+                  // so several pools can be open at once
 } BM_BufferPool;
 
 typedef struct BM_PageHandle {
@@ -47,13 +57,27 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
 		  void *stratData);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+// make every change marked with markDirty so far survive a crash through the
+// pool's write-ahead log; the pages themselves are written back later
+RC commitPool(BM_BufferPool *const bm);
+// write dirty pages no client is using in the background whenever more than
+// dirtyRatio (0 <= dirtyRatio < 1) of the frames are dirty, so misses find
+// clean victims; called again it changes the ratio of the running flusher.
+// shutdownBufferPool stops the flusher as well
+RC startPoolFlusher(BM_BufferPool *const bm, double dirtyRatio);
+RC stopPoolFlusher(BM_BufferPool *const bm);
 
-// Buffer Manager Interface Access Pages
+// Buffer Manager Interface Access Pages; safe to call from several threads
+// on the same pool at once
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 	    const PageNumber pageNum);
+// start reading pages into the pool without pinning them, so that pinning
+// them later finds them there or waits only for the rest of the read; pages
+// that find no free frame are skipped
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber *pageNums, int count);
 
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
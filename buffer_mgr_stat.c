@@ -25,7 +25,7 @@ printPoolContent (BM_BufferPool *const bm)
 	printf(" %i}: ", bm->numPages);
 
 	for (i = 0; i < bm->numPages; i++)
-		printf("%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+		printf("%s[%lld%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
 	printf("\n");
 }
 
@@ -45,7 +45,7 @@ sprintPoolContent (BM_BufferPool *const bm)
 	fixCount = getFixCounts(bm);
 
 	for (i = 0; i < bm->numPages; i++)
-		pos += sprintf(message + pos, "%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+		pos += sprintf(message + pos, "%s[%lld%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
 
 	return message;
 }
@@ -53,27 +53,40 @@ sprintPoolContent (BM_BufferPool *const bm)
 
 void
 printPageContent (BM_PageHandle *const page)
+{
+	printPageContentOf(page, PAGE_SIZE);
+}
+
+void
+printPageContentOf (BM_PageHandle *const page, int pageSize)
 {
 	int i;
 
-	printf("[Page %i]\n", page->pageNum);
+	printf("[Page %lld]\n", page->pageNum);
 
-	for (i = 1; i <= PAGE_SIZE; i++)
-		printf("%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
+	for (i = 1; i <= pageSize; i++)
+		printf("%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
 }
 
 char *
 sprintPageContent (BM_PageHandle *const page)
+{
+	return sprintPageContentOf(page, PAGE_SIZE);
+}
+
+char *
+sprintPageContentOf (BM_PageHandle *const page, int pageSize)
 {
 	int i;
 	char *message;
 	int pos = 0;
 
-	message = (char *) malloc(30 + (2 * PAGE_SIZE) + (PAGE_SIZE % 64) + (PAGE_SIZE % 8));
-	pos += sprintf(message + pos, "[Page %i]\n", page->pageNum);
+	// two digits per byte, a space after every 8 and a newline after every 64
+	message = (char *) malloc(30 + (2 * pageSize) + (pageSize / 8) + (pageSize / 64) + 1);
+	pos += sprintf(message + pos, "[Page %lld]\n", page->pageNum);
 
-	for (i = 1; i <= PAGE_SIZE; i++)
-		pos += sprintf(message + pos, "%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
+	for (i = 1; i <= pageSize; i++)
+		pos += sprintf(message + pos, "%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
 
 	return message;
 }
@@ -3,10 +3,14 @@
 
 #include "buffer_mgr.h"
 
-// debug functions
+// debug functions; printPageContent and sprintPageContent show the first
+// PAGE_SIZE bytes of the page, the Of versions pageSize bytes, e.g. the
+// pool's bm->pageSize
 void printPoolContent (BM_BufferPool *const bm);
 void printPageContent (BM_PageHandle *const page);
+void printPageContentOf (BM_PageHandle *const page, int pageSize);
 char *sprintPoolContent (BM_BufferPool *const bm);
 char *sprintPageContent (BM_PageHandle *const page);
+char *sprintPageContentOf (BM_PageHandle *const page, int pageSize);
 
 #endif
@@ -4,7 +4,18 @@
 #include "stdio.h"
 
 /* module wide constants */
+/* default page size; every page file records the size it was created with,
+ * one of 4, 8, 16, 32 or 64 KB (see setPageSize in storage_mgr.h) */
 #define PAGE_SIZE 4096
+#define PAGE_SIZE_MAX 65536
+/* the storage manager keeps a CRC32C of each page in its last bytes,
+ * upper layers only store data in the first PAGE_DATA_SIZE bytes */
+#define PAGE_CHECKSUM_SIZE 4
+#define PAGE_DATA_SIZE (PAGE_SIZE - PAGE_CHECKSUM_SIZE)
+#define PAGE_DATA_SIZE_OF(pageSize) ((pageSize) - PAGE_CHECKSUM_SIZE)
+
+/* page numbers and counts are 64 bit so page files can outgrow 2 GB */
+typedef long long PageNumber;
 
 /* return code definitions */
 typedef int RC;
@@ -17,6 +28,10 @@ typedef int RC;
 #define RC_READ_NON_EXISTING_PAGE 4
 #define RC_WRITE_NON_EXISTING_PAGE 5
 #define RC_RETURN 6
+#define RC_IO_MODE_NOT_SUPPORTED 10
+#define RC_UNALIGNED_BUFFER 11
+#define RC_CHECKSUM_MISMATCH 12
+#define RC_PAGE_SIZE_NOT_SUPPORTED 14
 
 #define RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE 200
 #define RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN 201
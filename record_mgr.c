@@ -64,7 +64,7 @@ char **extractAttributeNames(char *, int);
 int *extractAttributeDataType(char *, int);
 int *extractAttributeSize(char *, int);
 int *extractKeyData(char *data, int keyNum);
-int *extractFirstFreePageSlot(char *);
+PageNumber *extractFirstFreePageSlot(char *);
 int extractTotalRecords(char *);
 
 char *extractSingleAttributeData(char *, int);
@@ -83,7 +83,7 @@ int getAttributeRecordOffset(Schema *, int);
 */
 
 
-RC writeStrToPage(char *name, int pageNum, char *str) {
+RC writeStrToPage(char *name, PageNumber pageNum, char *str) {
 
 	RC result = RC_OK;
 	result = createPageFile(name);
@@ -140,7 +140,7 @@ void parsePageFileSchema(RM_TableData *rel, BM_PageHandle *h) // input parameter
     int *keys = extractKeyData(atrKeydt, totalKeyAtr);
 
     // fetch vacant page and slot location
-    int *pageSlot = extractFirstFreePageSlot(freeVacSlot);
+    PageNumber *pageSlot = extractFirstFreePageSlot(freeVacSlot);
 
     // fetch total number of tuples in a table
     int totaltuples = extractTotalRecords(meta);
@@ -178,7 +178,7 @@ void parsePageFileSchema(RM_TableData *rel, BM_PageHandle *h) // input parameter
 
     td_info.rm_tbl_data = rel;
     td_info.recordSize = getRecordSize(rel->schema) + 1; //
-    td_info.blkFctr = (PAGE_SIZE / td_info.recordSize);
+    td_info.blkFctr = (PAGE_DATA_SIZE_OF(td_info.bufferPool.pageSize) / td_info.recordSize);
     td_info.freeSpace.page = pageSlot[0];
     td_info.freeSpace.slot = pageSlot[1];
     td_info.totalRecords = totaltuples;
@@ -379,25 +379,25 @@ int *extractKeyData(char *data, int keyNum)
 }
 
 // extract first free page slot from page file on disk
-int *extractFirstFreePageSlot(char *data)
+PageNumber *extractFirstFreePageSlot(char *data)
 {
     int i = 0, j = 0, k = 0;
-    char *val = (char *)calloc(INT_SIZE, 2);
-    int *values = (int *)calloc(INT_SIZE, 2);
+    char *val = (char *)calloc(CHAR_SIZE, 24);
+    PageNumber *values = (PageNumber *)calloc(sizeof(PageNumber), 2);
     for (; data[k] != '\0';)
     {
         if (data[k] != ':')
             val[i++] = data[k++];
         else
         {
-            values[j++] = atoi(val);
-            memset(val, '\0', sizeof(int) * 2);
+            values[j++] = atoll(val);
+            memset(val, '\0', CHAR_SIZE * 24);
             i = 0;
             k++;
         }
     }
-    values[1] = atoi(val);
-    printf("\n Slot %d", values[1]);
+    values[1] = atoll(val);
+    printf("\n Slot %lld", values[1]);
     return values;
 }
 
@@ -473,7 +473,7 @@ RC createTable(char *name, Schema *schema)
 
     // Allocating memory to hold metadata information about the schema
     char *meta = (char *)calloc(PAGE_SIZE, 1);
-    sm_pageHandle = (SM_PageHandle)malloc(PAGE_SIZE);
+    sm_pageHandle = allocPageBuffer();
 
     // Storing name of relation
     sprintf(meta, "%s|", name);
@@ -508,7 +508,7 @@ RC createTable(char *name, Schema *schema)
     td_info.totalRecords = 0;
 
     // Appending vacant page-slot location
-    sprintf(meta + strlen(meta), "$%d:%d$", td_info.freeSpace.page, td_info.freeSpace.slot);
+    sprintf(meta + strlen(meta), "$%lld:%d$", td_info.freeSpace.page, td_info.freeSpace.slot);
 
     // Appending total number of tuples in relation
     sprintf(meta + strlen(meta), "?%d?", td_info.totalRecords);
@@ -519,7 +519,9 @@ RC createTable(char *name, Schema *schema)
     if ((code = openPageFile(name, &sm_fileHandle) != RC_OK) || (code = writeBlock(0, &sm_fileHandle, sm_pageHandle) != RC_OK))
         return code;
 
-    free(sm_pageHandle);
+    freePageBuffer(sm_pageHandle);
+    sm_pageHandle = NULL;
+    closePageFile(&sm_fileHandle);
     return RC_OK;
 }
 
@@ -581,7 +583,7 @@ RC closeTable(RM_TableData *rel)
     }
 
     strcat(meta, "}");
-    sprintf(meta + strlen(meta), "$%d:%d$", td_info.freeSpace.page, td_info.freeSpace.slot);
+    sprintf(meta + strlen(meta), "$%lld:%d$", td_info.freeSpace.page, td_info.freeSpace.slot);
     sprintf(meta + strlen(meta), "?%d?", td_info.totalRecords);
     if (code = pinPage(bm, page, 0) != RC_OK)
         return code;
@@ -626,7 +628,8 @@ RC insertRecord(RM_TableData *rel, Record *record)
     BM_PageHandle *page = &td_info.pageHandle;
     BM_BufferPool *bm = &td_info.bufferPool;
     char *pageData;
-    int recordSize, freePageNum, freeSlotNum, blockfactor;
+    int recordSize, freeSlotNum, blockfactor;
+    PageNumber freePageNum;
 
     recordSize = td_info.recordSize;
     freePageNum = td_info.freeSpace.page; // record will be inserted at this page number
@@ -674,7 +677,8 @@ RC deleteRecord(RM_TableData *rel, RID id)
     RC code = RC_OK;
     BM_PageHandle *page = &td_info.pageHandle;
     BM_BufferPool *bm = &td_info.bufferPool;
-    int recordSize, recordPageNumber, recordSlotNumber, blockfactor;
+    int recordSize, recordSlotNumber, blockfactor;
+    PageNumber recordPageNumber;
 
     recordSize = td_info.recordSize;
     blockfactor = td_info.blkFctr;
@@ -703,7 +707,8 @@ RC updateRecord(RM_TableData *rel, Record *record)
     RC code = RC_OK;
     BM_PageHandle *page = &td_info.pageHandle;
     BM_BufferPool *bm = &td_info.bufferPool;
-    int recordSize, recordPageNumber, recordSlotNumber, blockfactor, recordOffet;
+    int recordSize, recordSlotNumber, blockfactor, recordOffet;
+    PageNumber recordPageNumber;
 
     recordSize = td_info.recordSize;
     blockfactor = td_info.blkFctr;
@@ -729,7 +734,8 @@ RC getRecord(RM_TableData *rel, RID id, Record *record)
     RC code = RC_OK;
     BM_PageHandle *page = &td_info.pageHandle;
     BM_BufferPool *bm = &td_info.bufferPool;
-    int recordSize, recordPageNumber, recordSlotNumber, blockfactor, recordOffet;
+    int recordSize, recordSlotNumber, blockfactor, recordOffet;
+    PageNumber recordPageNumber;
 
     recordSize = td_info.recordSize;
     blockfactor = td_info.blkFctr;
@@ -778,7 +784,8 @@ RC next(RM_ScanHandle *scan, Record *record)
 
     BM_PageHandle *page = &td_info.pageHandle;
     BM_BufferPool *bm = &td_info.bufferPool;
-    int blockfactor, totalTuple, curTotalRecScan, curPgScan, curSlotScan;
+    int blockfactor, totalTuple, curTotalRecScan, curSlotScan;
+    PageNumber curPgScan;
     blockfactor = td_info.blkFctr;
     totalTuple = td_info.totalRecords;
 
@@ -1132,15 +1139,15 @@ void printTableInfoDetails(TD_info *tab_info)
     printf(" \n total Records in page (blkftr): %d", tab_info->blkFctr);
     printf(" \n total Attributes in table: %d", tab_info->rm_tbl_data->schema->numAttr);
     printf(" \n total Records in table: %d", tab_info->totalRecords);
-    printf(" \n next available page and slot: %d:%d", tab_info->freeSpace.page, tab_info->freeSpace.slot);
+    printf(" \n next available page and slot: %lld:%d", tab_info->freeSpace.page, tab_info->freeSpace.slot);
 }
 
-// function to print data of page
-void printPageData(char *pageData)
+// function to print data of a page of pageSize bytes, the pool's pageSize
+void printPageData(char *pageData, int pageSize)
 {
     printf("\n Prining page Data ==>");
     int i = 0;
-    for (; i < PAGE_SIZE;)
+    for (; i < pageSize;)
         printf("%c", pageData[i++]);
     printf("\n end of print... ");
 }
@@ -20,6 +20,7 @@ extern RC openTable (RM_TableData *rel, char *name);
 extern RC closeTable (RM_TableData *rel);
 extern RC deleteTable (char *name);
 extern int getNumTuples (RM_TableData *rel);
+extern RC writeStrToPage (char *name, PageNumber pageNum, char *str);
 
 // handling records in a table
 extern RC insertRecord (RM_TableData *rel, Record *record);
@@ -1,123 +1,1833 @@
+#define _GNU_SOURCE // mremap
+#define _FILE_OFFSET_BITS 64 // 64-bit off_t on 32-bit systems too
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <math.h>
 
 #include "storage_mgr.h"
 
-FILE *fptr;
+// io_uring is driven through raw syscalls so no extra library is needed;
+// build with -DSM_NO_IO_URING to always use the worker-thread fallback
+#if defined(__linux__) && !defined(SM_NO_IO_URING)
+#include <linux/io_uring.h>
+#define SM_HAVE_IO_URING 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define SM_HAVE_CRC_SSE42 1
+#elif defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define SM_HAVE_CRC_ARM 1
+#endif
+
+struct SM_AsyncCtx;
+struct SM_PageMap;
+struct SM_MemFile;
+struct SM_Backend;
+
+typedef uint32_t (*SM_PageCrcFn)(const unsigned char *memPage);
+
+// Bookkeeping stored in SM_FileHandle.mgmtInfo while a page file is open.
+// The descriptor stays open until closePageFile, so every page access is a
+// single positioned pread/pwrite and several files can be open at once.
+// Fields beyond the mode belong to the backend that uses them.
+typedef struct SM_FileMgmt
+{
+    int fd;          // descriptor of the open page file
+    SM_IOMode mode;  // how pages are moved, fixed at openPageFile
+    int pageSize;    // bytes per page, read from the file by the backend
+    PageNumber fsmGroup;  // pages covered by one free-space bitmap
+    SM_PageCrcFn pageCrc; // checksum kernel for pageSize pages
+    char *map;       // SM_IO_MMAP: mapping of the whole file
+    size_t mapLen;   // SM_IO_MMAP: length of the mapping in bytes
+    off_t reserved;  // SM_IO_FILE: bytes with disk extents allocated
+    int freePages;   // pages marked free in the free-space map
+    PageNumber nextRead;  // page following the last one read
+    PageNumber seqPages;  // pages read in a row up to nextRead
+    PageNumber aheadEnd;  // readahead has been requested up to this page
+    int scanOnce;         // only read, in one forward pass, since opened
+    struct SM_PageMap *pageMap; // SM_IO_COMPRESSED: where each page is stored
+    struct SM_MemFile *memFile; // SM_IO_MEMORY: the file's pages
+    const struct SM_Backend *backend; // stores the pages, chosen by mode
+    struct SM_AsyncCtx *async; // asynchronous I/O state, created on first use
+} SM_FileMgmt;
+
+#define FILE_MGMT(fHandle) ((SM_FileMgmt *)(fHandle)->mgmtInfo)
+
+// Page files start with this header. It takes the first bytes of the first
+// free-space bitmap page (see SM_FSM_HEADER_SIZE), so the page size can be
+// read before the pages can be located.
+typedef struct SM_FileHeader
+{
+    char magic[4];
+    uint32_t pageSize;
+    uint32_t fileId; // tells this file from an earlier one of the same name
+} SM_FileHeader;
+
+#define SM_FILE_MAGIC "SMPF"
+
+// I/O mode used by openPageFile for files opened from now on
+static SM_IOMode ioMode = SM_IO_FILE;
+
+// Page size used by createPageFile for files created from now on
+static int filePageSize = PAGE_SIZE;
+
+// Largest number of pages reserved ahead of a growing file (see growFile)
+static int growthChunkPages = SM_DEFAULT_GROWTH_CHUNK;
+
+/************************************************************
+ *              page checksums (CRC32C)                     *
+ ************************************************************/
+
+// Every page carries the CRC32C of all but its last PAGE_CHECKSUM_SIZE bytes
+// in those bytes (little endian). The checksum is computed with the SSE4.2 /
+// ARMv8 CRC32 instructions where the CPU has them, chosen once at run time,
+// and with a byte-wise table otherwise. The instruction has a latency of
+// several cycles but can start one per cycle, so every SM_CRC_BLOCK bytes are
+// split into three lanes that are checksummed side by side and then combined.
+// A kernel is compiled for each of SM_PAGE_SIZES so its loops have constant
+// bounds; an open file keeps the one for its page size.
+
+// bytes per lane; a 4 KB page is one block plus a few bytes added at the end
+#define SM_CRC_LANE ((PAGE_DATA_SIZE / 24) * 8)
+#define SM_CRC_BLOCK (3 * SM_CRC_LANE)
+
+static uint32_t crc32cTable[256];
+// crcShift[k][b]: byte k of a CRC equal to b moved past SM_CRC_LANE zero bytes
+static uint32_t crcShift[4][256];
+static int crcHw = 0; // the CPU has a CRC32C instruction
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+static uint32_t crc32cSoft(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    for (; len > 0; buf++, len--)
+        crc = crc32cTable[(crc ^ *buf) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#define SM_CRC_SOFT_KERNEL(pageSize)                                          \
+    static uint32_t pageCrcSoft##pageSize(const unsigned char *memPage)       \
+    {                                                                         \
+        return crc32cSoft(~(uint32_t)0, memPage, PAGE_DATA_SIZE_OF(pageSize)); \
+    }
+SM_PAGE_SIZES(SM_CRC_SOFT_KERNEL)
 
-extern void initStorageManager(void)
+// CRC of lane A followed by lane B, given the CRC of A and B's CRC from zero
+static uint32_t crcAppendLane(uint32_t crcA, uint32_t crcB)
 {
-    // Initialising file pointer i.e. storage manager.
-    fptr = NULL;
+    return crcShift[0][crcA & 0xff] ^ crcShift[1][(crcA >> 8) & 0xff] ^
+           crcShift[2][(crcA >> 16) & 0xff] ^ crcShift[3][crcA >> 24] ^ crcB;
 }
 
-extern RC createPageFile(char *fileName)
+#ifdef SM_HAVE_CRC_SSE42
+#ifdef __x86_64__
+#define SM_CRC_WORD(crc, word) _mm_crc32_u64(crc, word)
+#else
+#define SM_CRC_WORD(crc, word) _mm_crc32_u32(_mm_crc32_u32(crc, (uint32_t)(word)), (uint32_t)((word) >> 32))
+#endif
+#define SM_CRC_BYTE(crc, byte) _mm_crc32_u8(crc, byte)
+#define SM_CRC_TARGET __attribute__((target("sse4.2")))
+#endif
+
+#ifdef SM_HAVE_CRC_ARM
+#define SM_CRC_WORD(crc, word) __crc32cd(crc, word)
+#define SM_CRC_BYTE(crc, byte) __crc32cb(crc, byte)
+#define SM_CRC_TARGET __attribute__((target("+crc")))
+#endif
+
+#ifdef SM_CRC_TARGET
+SM_CRC_TARGET
+static uint32_t crc32cHw(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    for (; len >= 8; buf += 8, len -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, buf, 8);
+        crc = SM_CRC_WORD(crc, word);
+    }
+    for (; len > 0; buf++, len--)
+        crc = SM_CRC_BYTE(crc, *buf);
+    return crc;
+}
+
+// inlined into each kernel below, where len is a constant
+SM_CRC_TARGET __attribute__((always_inline))
+static inline uint32_t crcBlocksHw(const unsigned char *buf, size_t len)
+{
+    const unsigned char *end = buf + len / SM_CRC_BLOCK * SM_CRC_BLOCK;
+    uint32_t crcA = ~(uint32_t)0;
+
+    for (; buf < end; buf += SM_CRC_BLOCK)
+    {
+        uint32_t crcB = 0, crcC = 0;
+        for (const unsigned char *lane = buf; lane < buf + SM_CRC_LANE; lane += 8)
+        {
+            uint64_t wordA, wordB, wordC;
+            memcpy(&wordA, lane, 8);
+            memcpy(&wordB, lane + SM_CRC_LANE, 8);
+            memcpy(&wordC, lane + 2 * SM_CRC_LANE, 8);
+            crcA = SM_CRC_WORD(crcA, wordA);
+            crcB = SM_CRC_WORD(crcB, wordB);
+            crcC = SM_CRC_WORD(crcC, wordC);
+        }
+        crcA = crcAppendLane(crcAppendLane(crcA, crcB), crcC);
+    }
+    return crc32cHw(crcA, end, len % SM_CRC_BLOCK);
+}
+
+#define SM_CRC_HW_KERNEL(pageSize)                                    \
+    SM_CRC_TARGET                                                     \
+    static uint32_t pageCrcHw##pageSize(const unsigned char *memPage) \
+    {                                                                 \
+        return crcBlocksHw(memPage, PAGE_DATA_SIZE_OF(pageSize));     \
+    }
+SM_PAGE_SIZES(SM_CRC_HW_KERNEL)
+#endif
+
+// Build the tables and probe the CPU, once per process
+static void initCrc(void)
+{
+    static const unsigned char zeros[SM_CRC_LANE];
+    uint32_t bitShift[32];
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : c >> 1; // reflected Castagnoli polynomial
+        crc32cTable[i] = c;
+    }
+
+    // the CRC is linear, so moving it past the zeros is a XOR of its bits moved
+    for (int bit = 0; bit < 32; bit++)
+        bitShift[bit] = crc32cSoft((uint32_t)1 << bit, zeros, SM_CRC_LANE);
+    for (int k = 0; k < 4; k++)
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            uint32_t c = 0;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                if (b & (1 << bit))
+                    c ^= bitShift[8 * k + bit];
+            }
+            crcShift[k][b] = c;
+        }
+    }
+
+#if defined(SM_HAVE_CRC_SSE42)
+    crcHw = __builtin_cpu_supports("sse4.2");
+#elif defined(SM_HAVE_CRC_ARM)
+    crcHw = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+}
+
+// Checksum kernel for pages of pageSize bytes, NULL if the size is not supported
+static SM_PageCrcFn pageCrcFor(int pageSize)
+{
+    pthread_once(&crcOnce, initCrc);
+
+    switch (pageSize)
+    {
+#ifdef SM_CRC_TARGET
+#define SM_CRC_CASE(size) \
+    case size:            \
+        return crcHw ? pageCrcHw##size : pageCrcSoft##size;
+#else
+#define SM_CRC_CASE(size) \
+    case size:            \
+        return pageCrcSoft##size;
+#endif
+        SM_PAGE_SIZES(SM_CRC_CASE)
+    }
+    return NULL;
+}
+
+// CRC32C of any run of bytes, with the same polynomial as the page trailers
+extern unsigned int checksumBytes(const char *data, int len)
+{
+    pthread_once(&crcOnce, initCrc);
+#ifdef SM_CRC_TARGET
+    if (crcHw)
+        return ~crc32cHw(~(uint32_t)0, (const unsigned char *)data, len);
+#endif
+    return ~crc32cSoft(~(uint32_t)0, (const unsigned char *)data, len);
+}
+
+static uint32_t pageChecksum(SM_FileMgmt *mgmt, const char *memPage)
 {
-    // Create a new page file fileName.
-    // The initial file size should be one page. 4096 bytes
-    // This method should fill this single page with '\0' bytes
+    return ~(*mgmt).pageCrc((const unsigned char *)memPage);
+}
 
-    // open new file and perform read+write operation
-    fptr = fopen(fileName, "w+");
+// Store the page's checksum in its trailer
+static void stampPage(SM_FileMgmt *mgmt, char *memPage)
+{
+    uint32_t crc = pageChecksum(mgmt, memPage);
+    unsigned char *trailer = (unsigned char *)memPage + PAGE_DATA_SIZE_OF((*mgmt).pageSize);
+
+    trailer[0] = crc;
+    trailer[1] = crc >> 8;
+    trailer[2] = crc >> 16;
+    trailer[3] = crc >> 24;
+}
+
+// Check a page read from disk against its trailer. A page that was never
+// written (file growth leaves zeros, trailer included) is accepted as well.
+static RC verifyPage(SM_FileMgmt *mgmt, const char *memPage)
+{
+    const unsigned char *trailer = (const unsigned char *)memPage + PAGE_DATA_SIZE_OF((*mgmt).pageSize);
+    uint32_t stored = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | (uint32_t)trailer[3] << 24;
+
+    if (stored == pageChecksum(mgmt, memPage))
+        return RC_OK;
+    if (stored != 0)
+        return RC_CHECKSUM_MISMATCH;
+    for (int i = 0; i < PAGE_DATA_SIZE_OF((*mgmt).pageSize); i++)
+    {
+        if (memPage[i] != 0)
+            return RC_CHECKSUM_MISMATCH;
+    }
+    return RC_OK;
+}
+
+// Read exactly len bytes at byte offset 'offset', retrying short reads
+static RC readBytesAt(int fd, off_t offset, char *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        ssize_t n = pread(fd, buf + done, len - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return RC_READ_NON_EXISTING_PAGE;
+        done += n;
+    }
+    return RC_OK;
+}
+
+// Write exactly len bytes at byte offset 'offset', retrying short writes
+static RC writeBytesAt(int fd, off_t offset, const char *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        ssize_t n = pwrite(fd, buf + done, len - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return RC_WRITE_FAILED;
+        done += n;
+    }
+    return RC_OK;
+}
+
+// Transfer a run of whole pages with preadv/pwritev starting at byte offset
+// 'offset'. Short transfers are resumed from where they stopped. iov is
+// consumed in the process.
+static RC transferPagesAt(int fd, int write, off_t offset, struct iovec *iov, int iovCnt)
+{
+    while (iovCnt > 0)
+    {
+        int batch = iovCnt < IOV_MAX ? iovCnt : IOV_MAX;
+        ssize_t n = write ? pwritev(fd, iov, batch, offset) : preadv(fd, iov, batch, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+
+        offset += n;
+        // skip the buffers that were filled completely, trim a partial one
+        for (; iovCnt > 0 && (size_t)n >= (*iov).iov_len; iov++, iovCnt--)
+            n -= (*iov).iov_len;
+        if (n > 0)
+        {
+            (*iov).iov_base = (char *)(*iov).iov_base + n;
+            (*iov).iov_len -= n;
+        }
+    }
+    return RC_OK;
+}
+
+/************************************************************
+ *              storage backends                            *
+ ************************************************************/
+
+// A backend stores the physical pages of a page file. openPageFile picks one
+// from the current I/O mode and keeps it for the life of the handle. Page
+// numbers are physical here: checksums and the free-space map are handled by
+// the generic code above the backends. Each backend records the file's page
+// size and sets (*mgmt).pageSize from it on open.
+typedef struct SM_Backend
+{
+    int inMemory;     // pages are memory copies, async requests complete inline
+    int writeExtends; // writing one past the last page grows the file by itself
+    // numPages pages of pageSize bytes, all zeros but firstPage
+    RC (*create)(const char *fileName, int pageSize, PageNumber numPages, const char *firstPage);
+    RC (*open)(const char *fileName, SM_FileMgmt *mgmt, PageNumber *numPages);
+    RC (*close)(SM_FileMgmt *mgmt);
+    RC (*destroy)(const char *fileName);
+    RC (*read)(SM_FileMgmt *mgmt, PageNumber pageNum, char *memPage);
+    RC (*write)(SM_FileMgmt *mgmt, PageNumber pageNum, const char *memPage);
+    // count consecutive pages in one call; NULL moves them one by one
+    RC (*transferv)(SM_FileMgmt *mgmt, int write, PageNumber startPage, int count, SM_PageHandle *memPages);
+    // make room for numPages pages, aheadPages being the expected future size
+    RC (*grow)(SM_FileMgmt *mgmt, PageNumber numPages, PageNumber aheadPages);
+    // the page is free, its storage may be given back
+    void (*release)(SM_FileMgmt *mgmt, PageNumber pageNum);
+    // stable address of the page, NULL when pages are not addressable
+    char *(*pagePtr)(SM_FileMgmt *mgmt, PageNumber pageNum);
+    // tell the OS cache the pages are needed soon (willNeed) or no longer;
+    // NULL when the pages are not cached by the OS
+    void (*advise)(SM_FileMgmt *mgmt, PageNumber startPage, PageNumber count, int willNeed);
+    // make the pages written so far survive a crash
+    RC (*sync)(SM_FileMgmt *mgmt);
+} SM_Backend;
+
+// --- POSIX file backend (SM_IO_FILE, SM_IO_DIRECT) ---
+
+static RC diskCreate(const char *fileName, int pageSize, PageNumber numPages, const char *firstPage)
+{
+    // open new file (truncating any existing one) for read+write
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
     // check if file opened succesfully
-    if (fptr == NULL)
+    if (fd < 0)
         return RC_FILE_NOT_FOUND;
 
-    // Create a page and fill it with '\0' bytes
-    SM_PageHandle page = (SM_PageHandle)malloc(PAGE_SIZE * sizeof(char));
-    memset(page, 0, PAGE_SIZE); // set all bytes in page to '\0'
+    // zero pages are valid pages (see verifyPage), a hole is all they need
+    RC code = writeBytesAt(fd, 0, firstPage, pageSize);
+    if (code == RC_OK && ftruncate(fd, (off_t)pageSize * numPages) != 0)
+        code = RC_WRITE_FAILED;
+
+    close(fd); // close file
+    return code;
+}
+
+// Open the descriptor of a page file, noting its size in (*mgmt).reserved
+static RC openDescriptor(const char *fileName, SM_FileMgmt *mgmt)
+{
+    int fd = open(fileName, O_RDWR | ((*mgmt).mode == SM_IO_DIRECT ? O_DIRECT : 0));
+
+    if (fd < 0)
+    {
+        // the file exists but its file system cannot bypass the page cache
+        if ((*mgmt).mode == SM_IO_DIRECT && errno == EINVAL)
+            return RC_IO_MODE_NOT_SUPPORTED;
+        return RC_FILE_NOT_FOUND;
+    }
+
+    // struct stat to obtain file size
+    struct stat fileinfo;
+    // success if 0, else -1
+    if (fstat(fd, &fileinfo) != 0)
+    {
+        close(fd);
+        return RC_FAILED;
+    }
+
+    (*mgmt).fd = fd;
+    (*mgmt).reserved = fileinfo.st_size;
+    return RC_OK;
+}
+
+static RC diskOpen(const char *fileName, SM_FileMgmt *mgmt, PageNumber *numPages)
+{
+    RC code = openDescriptor(fileName, mgmt);
+    if (code != RC_OK)
+        return code;
+
+    // the header is read a whole (aligned) 4 KB page at a time for O_DIRECT
+    SM_PageHandle first = allocPageBufferOf(PAGE_SIZE);
+    if (first == NULL)
+        code = RC_MELLOC_MEM_ALLOC_FAILED;
+    else if (readBytesAt((*mgmt).fd, 0, first, PAGE_SIZE) != RC_OK || memcmp(first, SM_FILE_MAGIC, 4) != 0)
+        code = RC_IO_MODE_NOT_SUPPORTED; // not a page file, or a compressed one
+    else
+        (*mgmt).pageSize = (*(SM_FileHeader *)first).pageSize;
+    freePageBuffer(first);
+
+    if (code != RC_OK || (*mgmt).pageSize <= 0)
+    {
+        close((*mgmt).fd);
+        return code != RC_OK ? code : RC_PAGE_SIZE_NOT_SUPPORTED;
+    }
+    *numPages = (*mgmt).reserved / (*mgmt).pageSize;
+    return RC_OK;
+}
+
+static RC diskClose(SM_FileMgmt *mgmt)
+{
+    // release the descriptor held since openPageFile
+    close((*mgmt).fd);
+    return RC_OK;
+}
+
+static RC diskDestroy(const char *fileName)
+{
+    // check if file exists
+    if (access(fileName, F_OK) != 0)
+        return RC_FILE_NOT_FOUND;
+
+    // delete file
+    if (remove(fileName) != 0)
+        return RC_FAILED;
+
+    return RC_OK;
+}
+
+static RC fileRead(SM_FileMgmt *mgmt, PageNumber pageNum, char *memPage)
+{
+    return readBytesAt((*mgmt).fd, (off_t)(*mgmt).pageSize * pageNum, memPage, (*mgmt).pageSize);
+}
+
+static RC fileWrite(SM_FileMgmt *mgmt, PageNumber pageNum, const char *memPage)
+{
+    return writeBytesAt((*mgmt).fd, (off_t)(*mgmt).pageSize * pageNum, memPage, (*mgmt).pageSize);
+}
+
+static RC fileTransferv(SM_FileMgmt *mgmt, int write, PageNumber startPage, int count, SM_PageHandle *memPages)
+{
+    struct iovec iovStack[64];
+    struct iovec *iov = count <= 64 ? iovStack : (struct iovec *)malloc(count * sizeof(struct iovec));
+    if (iov == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+
+    for (int i = 0; i < count; i++)
+    {
+        iov[i].iov_base = memPages[i];
+        iov[i].iov_len = (*mgmt).pageSize;
+    }
+    RC code = transferPagesAt((*mgmt).fd, write, (off_t)(*mgmt).pageSize * startPage, iov, count);
+
+    if (iov != iovStack)
+        free(iov);
+    return code;
+}
+
+// Grow the file with a single ftruncate, which leaves a hole instead of
+// writing zeros. Disk extents are reserved ahead of the new end in bulk
+// (fallocate KEEP_SIZE) so later appends find them already allocated.
+static RC fileGrow(SM_FileMgmt *mgmt, PageNumber numPages, PageNumber aheadPages)
+{
+    off_t newLen = (off_t)(*mgmt).pageSize * numPages;
+    off_t aheadLen = (off_t)(*mgmt).pageSize * aheadPages;
+
+    if (ftruncate((*mgmt).fd, newLen) != 0)
+        return RC_WRITE_FAILED;
+
+#ifdef __linux__
+    if (newLen > (*mgmt).reserved)
+    {
+        // best effort, a file system without fallocate simply allocates on write
+        if (fallocate((*mgmt).fd, FALLOC_FL_KEEP_SIZE, newLen, aheadLen - newLen) == 0)
+            (*mgmt).reserved = aheadLen;
+        else
+            (*mgmt).reserved = newLen;
+    }
+#endif
+    return RC_OK;
+}
+
+// Punch the page out of the file. Best effort: a page that cannot be
+// released simply keeps its old contents.
+static void fileRelease(SM_FileMgmt *mgmt, PageNumber pageNum)
+{
+#ifdef __linux__
+    fallocate((*mgmt).fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)(*mgmt).pageSize * pageNum, (*mgmt).pageSize);
+#endif
+}
+
+// Best effort like fileRelease. SM_IO_DIRECT reads bypass the cache, so
+// there is nothing to warm up or drop for them.
+static void fileAdvise(SM_FileMgmt *mgmt, PageNumber startPage, PageNumber count, int willNeed)
+{
+    if ((*mgmt).mode == SM_IO_DIRECT)
+        return;
+    posix_fadvise((*mgmt).fd, (off_t)(*mgmt).pageSize * startPage, (off_t)(*mgmt).pageSize * count,
+                  willNeed ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED);
+}
+
+static RC fileSync(SM_FileMgmt *mgmt)
+{
+    return fdatasync((*mgmt).fd) == 0 ? RC_OK : RC_WRITE_FAILED;
+}
+
+static const SM_Backend fileBackend = {
+    0, 1, diskCreate, diskOpen, diskClose, diskDestroy,
+    fileRead, fileWrite, fileTransferv, fileGrow, fileRelease, NULL, fileAdvise, fileSync};
+
+// --- memory-mapped file backend (SM_IO_MMAP) ---
+
+static RC mmapOpen(const char *fileName, SM_FileMgmt *mgmt, PageNumber *numPages)
+{
+    RC code = diskOpen(fileName, mgmt, numPages);
+    if (code != RC_OK)
+        return code;
+
+    // map the whole file so page reads and writes become plain memcpy
+    (*mgmt).mapLen = (size_t)(*mgmt).pageSize * *numPages;
+    (*mgmt).map = mmap(NULL, (*mgmt).mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, (*mgmt).fd, 0);
+    if ((*mgmt).map == MAP_FAILED)
+    {
+        close((*mgmt).fd);
+        return RC_FAILED;
+    }
+    return RC_OK;
+}
+
+static RC mmapClose(SM_FileMgmt *mgmt)
+{
+    // drop the mapping, its pages are already in the page cache
+    munmap((*mgmt).map, (*mgmt).mapLen);
+    return diskClose(mgmt);
+}
+
+static RC mmapRead(SM_FileMgmt *mgmt, PageNumber pageNum, char *memPage)
+{
+    size_t offset = (size_t)(*mgmt).pageSize * pageNum;
+
+    if (offset + (*mgmt).pageSize > (*mgmt).mapLen)
+        return RC_READ_NON_EXISTING_PAGE;
+    memcpy(memPage, (*mgmt).map + offset, (*mgmt).pageSize);
+    return RC_OK;
+}
 
-    // write page bytes into file
-    if (fwrite(page, sizeof(char), PAGE_SIZE, fptr) < PAGE_SIZE)
+static RC mmapWrite(SM_FileMgmt *mgmt, PageNumber pageNum, const char *memPage)
+{
+    size_t offset = (size_t)(*mgmt).pageSize * pageNum;
+
+    if (offset + (*mgmt).pageSize > (*mgmt).mapLen)
+        return RC_WRITE_NON_EXISTING_PAGE;
+    memcpy((*mgmt).map + offset, memPage, (*mgmt).pageSize);
+    return RC_OK;
+}
+
+// Grow the file like fileGrow and extend the mapping ahead of it with
+// mremap, which invalidates pointers handed out by getBlockPtr
+static RC mmapGrow(SM_FileMgmt *mgmt, PageNumber numPages, PageNumber aheadPages)
+{
+    size_t newLen = (size_t)(*mgmt).pageSize * numPages;
+    size_t aheadLen = (size_t)(*mgmt).pageSize * aheadPages;
+
+    if (ftruncate((*mgmt).fd, newLen) != 0)
         return RC_WRITE_FAILED;
 
-    free(page);   // dispose memory
-    fclose(fptr); // close file
+    if (newLen > (*mgmt).mapLen)
+    {
+        // the mapping may reach past the end of file, those pages are never touched
+        char *map = mremap((*mgmt).map, (*mgmt).mapLen, aheadLen, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED)
+            return RC_WRITE_FAILED;
+
+        (*mgmt).map = map;
+        (*mgmt).mapLen = aheadLen;
+    }
+    return RC_OK;
+}
+
+static char *mmapPagePtr(SM_FileMgmt *mgmt, PageNumber pageNum)
+{
+    return (*mgmt).map + (size_t)(*mgmt).pageSize * pageNum;
+}
 
-    return RC_OK; // ok
+// Read the pages into the page cache behind the mapping, or drop them from it
+static void mmapAdvise(SM_FileMgmt *mgmt, PageNumber startPage, PageNumber count, int willNeed)
+{
+    if (willNeed)
+        madvise(mmapPagePtr(mgmt, startPage), (size_t)(*mgmt).pageSize * count, MADV_WILLNEED);
+    else
+        fileAdvise(mgmt, startPage, count, 0);
+}
+
+// the pages went into the mapping, the file size through the descriptor
+static RC mmapSync(SM_FileMgmt *mgmt)
+{
+    if ((*mgmt).map != NULL && msync((*mgmt).map, (*mgmt).mapLen, MS_SYNC) != 0)
+        return RC_WRITE_FAILED;
+    return fileSync(mgmt);
+}
+
+static const SM_Backend mmapBackend = {
+    1, 0, diskCreate, mmapOpen, mmapClose, diskDestroy,
+    mmapRead, mmapWrite, NULL, mmapGrow, fileRelease, mmapPagePtr, mmapAdvise, mmapSync};
+
+/************************************************************
+ *              compressed page files                       *
+ ************************************************************/
+
+// In SM_IO_COMPRESSED mode every page is compressed with a small LZ77 codec
+// (LZ4 block layout) and stored in a variable size extent. The file starts
+// with a header that locates the page map, an array with one SM_PageExtent
+// per page stored after the last extent. The map is kept in memory while the
+// file is open and written back by closePageFile. Space not covered by any
+// extent of the stored map is found again by openPageFile and reused.
+//
+//   token     literal count (high 4 bits), match length - 4 (low 4 bits),
+//             a nibble of 15 continues in following bytes while they are 255
+//   literals  copied as is
+//   offset    2 bytes little endian, distance back to the match
+//
+// The last sequence of a page has literals only.
+
+#define SM_CZ_MAGIC "SMCZPG02"
+#define SM_CZ_HEADER_SIZE PAGE_SIZE
+#define SM_CZ_GRANULE 256 // extents are allocated in multiples of this
+#define SM_LZ_MIN_MATCH 4
+#define SM_LZ_HASH_BITS 12
+
+typedef struct SM_CzHeader
+{
+    char magic[8];
+    int64_t numPages;
+    int64_t mapOffset; // byte offset of the page map, also the end of the data
+    int64_t pageSize;  // bytes per page once expanded
+} SM_CzHeader;
+
+// Location of one compressed page. length 0 is a page of zeros that was never
+// written, length pageSize a page stored uncompressed.
+typedef struct SM_PageExtent
+{
+    int64_t offset;
+    int32_t length;
+    int32_t capacity;
+} SM_PageExtent;
+
+typedef struct SM_PageMap
+{
+    SM_PageExtent *pages;
+    PageNumber numPages, maxPages;
+    int64_t dataEnd;       // extents are appended here
+    SM_PageExtent *spare;  // free space below dataEnd, in no particular order
+    int numSpare, maxSpare;
+    unsigned char *packed; // one compressed page on its way to or from the file
+} SM_PageMap;
+
+static unsigned char *lzPutLength(unsigned char *out, int len)
+{
+    for (; len >= 255; len -= 255)
+        *out++ = 255;
+    *out++ = len;
+    return out;
+}
+
+// Compress one page of pageSize bytes into out. Returns the compressed length,
+// or 0 when the result would not fit into limit bytes. Positions and match
+// offsets fit 16 bits up to PAGE_SIZE_MAX.
+static int lzCompress(const unsigned char *in, int pageSize, unsigned char *out, int limit)
+{
+    uint16_t lastPos[1 << SM_LZ_HASH_BITS];
+    const unsigned char *ip = in, *anchor = in, *end = in + pageSize;
+    unsigned char *op = out, *opEnd = out + limit;
+
+    memset(lastPos, 0, sizeof(lastPos));
+    while (ip + SM_LZ_MIN_MATCH <= end)
+    {
+        uint32_t seq, refSeq;
+        memcpy(&seq, ip, 4);
+        uint32_t h = (seq * 2654435761u) >> (32 - SM_LZ_HASH_BITS);
+        const unsigned char *ref = in + lastPos[h];
+        lastPos[h] = ip - in;
+        memcpy(&refSeq, ref, 4);
+        if (ref >= ip || refSeq != seq)
+        {
+            ip++;
+            continue;
+        }
+
+        int matchLen = SM_LZ_MIN_MATCH;
+        while (ip + matchLen < end && ref[matchLen] == ip[matchLen])
+            matchLen++;
+
+        int litLen = ip - anchor;
+        if (op + 1 + litLen + litLen / 255 + 1 + 2 + matchLen / 255 + 1 > opEnd)
+            return 0;
+
+        unsigned char *token = op++;
+        *token = (litLen < 15 ? litLen : 15) << 4;
+        if (litLen >= 15)
+            op = lzPutLength(op, litLen - 15);
+        memcpy(op, anchor, litLen);
+        op += litLen;
+
+        int offset = ip - ref;
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+        int extra = matchLen - SM_LZ_MIN_MATCH;
+        *token |= extra < 15 ? extra : 15;
+        if (extra >= 15)
+            op = lzPutLength(op, extra - 15);
+
+        ip += matchLen;
+        anchor = ip;
+    }
+
+    int litLen = end - anchor;
+    if (op + 1 + litLen + litLen / 255 + 1 > opEnd)
+        return 0;
+    *op++ = (litLen < 15 ? litLen : 15) << 4;
+    if (litLen >= 15)
+        op = lzPutLength(op, litLen - 15);
+    memcpy(op, anchor, litLen);
+    op += litLen;
+    return op - out;
+}
+
+// Read a length continued past its nibble; -1 if the input runs out
+static int lzGetLength(const unsigned char **ip, const unsigned char *ipEnd, int len)
+{
+    unsigned char b;
+
+    if (len != 15)
+        return len;
+    do
+    {
+        if (*ip >= ipEnd)
+            return -1;
+        b = *(*ip)++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+// Expand inLen compressed bytes into exactly one page of pageSize bytes
+static RC lzDecompress(const unsigned char *in, int inLen, unsigned char *out, int pageSize)
+{
+    const unsigned char *ip = in, *ipEnd = in + inLen;
+    unsigned char *op = out, *opEnd = out + pageSize;
+
+    while (ip < ipEnd)
+    {
+        int token = *ip++;
+        int litLen = lzGetLength(&ip, ipEnd, token >> 4);
+        if (litLen < 0 || litLen > ipEnd - ip || litLen > opEnd - op)
+            return RC_CHECKSUM_MISMATCH;
+        memcpy(op, ip, litLen);
+        op += litLen;
+        ip += litLen;
+        if (ip == ipEnd)
+            break;
+
+        if (ipEnd - ip < 2)
+            return RC_CHECKSUM_MISMATCH;
+        int offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        int matchLen = lzGetLength(&ip, ipEnd, token & 15);
+        if (matchLen < 0)
+            return RC_CHECKSUM_MISMATCH;
+        matchLen += SM_LZ_MIN_MATCH;
+        if (offset == 0 || offset > op - out || matchLen > opEnd - op)
+            return RC_CHECKSUM_MISMATCH;
+        // byte by byte: the match may overlap the bytes it produces
+        for (int i = 0; i < matchLen; i++)
+            op[i] = op[i - offset];
+        op += matchLen;
+    }
+    return op == opEnd ? RC_OK : RC_CHECKSUM_MISMATCH;
+}
+
+// Make room for numPages entries, new pages are zero pages
+static RC growPageMap(SM_PageMap *map, PageNumber numPages)
+{
+    if (numPages > (*map).maxPages)
+    {
+        PageNumber maxPages = (*map).maxPages * 2 > numPages ? (*map).maxPages * 2 : numPages;
+        SM_PageExtent *pages = (SM_PageExtent *)realloc((*map).pages, maxPages * sizeof(SM_PageExtent));
+        if (pages == NULL)
+            return RC_MELLOC_MEM_ALLOC_FAILED;
+        (*map).pages = pages;
+        (*map).maxPages = maxPages;
+    }
+    if (numPages > (*map).numPages)
+    {
+        memset((*map).pages + (*map).numPages, 0, (numPages - (*map).numPages) * sizeof(SM_PageExtent));
+        (*map).numPages = numPages;
+    }
+    return RC_OK;
+}
+
+// Find an extent of capacity bytes, carving it from a spare one if possible
+static int64_t allocExtent(SM_PageMap *map, int capacity)
+{
+    for (int i = (*map).numSpare - 1; i >= 0; i--)
+    {
+        if ((*map).spare[i].capacity >= capacity)
+        {
+            int64_t offset = (*map).spare[i].offset;
+            (*map).spare[i].offset += capacity;
+            (*map).spare[i].capacity -= capacity;
+            if ((*map).spare[i].capacity == 0)
+                (*map).spare[i] = (*map).spare[--(*map).numSpare];
+            return offset;
+        }
+    }
+
+    int64_t offset = (*map).dataEnd;
+    (*map).dataEnd += capacity;
+    return offset;
+}
+
+// Remember an extent a page no longer uses, losing it if out of memory
+static void releaseExtent(SM_PageMap *map, SM_PageExtent *extent)
+{
+    if ((*map).numSpare == (*map).maxSpare)
+    {
+        int maxSpare = (*map).maxSpare ? (*map).maxSpare * 2 : 16;
+        SM_PageExtent *spare = (SM_PageExtent *)realloc((*map).spare, maxSpare * sizeof(SM_PageExtent));
+        if (spare == NULL)
+            return;
+        (*map).spare = spare;
+        (*map).maxSpare = maxSpare;
+    }
+    (*map).spare[(*map).numSpare++] = *extent;
+}
+
+static RC compressedRead(SM_FileMgmt *mgmt, PageNumber pageNum, char *memPage)
+{
+    SM_PageMap *map = (*mgmt).pageMap;
+
+    if (pageNum >= (*map).numPages)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    SM_PageExtent *extent = &(*map).pages[pageNum];
+    if ((*extent).length == 0)
+    {
+        memset(memPage, 0, (*mgmt).pageSize);
+        return RC_OK;
+    }
+    if ((*extent).length == (*mgmt).pageSize)
+        return readBytesAt((*mgmt).fd, (*extent).offset, memPage, (*mgmt).pageSize);
+
+    RC code = readBytesAt((*mgmt).fd, (*extent).offset, (char *)(*map).packed, (*extent).length);
+    if (code != RC_OK)
+        return code;
+    return lzDecompress((*map).packed, (*extent).length, (unsigned char *)memPage, (*mgmt).pageSize);
+}
+
+static RC compressedWrite(SM_FileMgmt *mgmt, PageNumber pageNum, const char *memPage)
+{
+    SM_PageMap *map = (*mgmt).pageMap;
+    const char *data = (const char *)(*map).packed;
+
+    if (pageNum >= (*map).numPages)
+        return RC_WRITE_NON_EXISTING_PAGE;
+
+    // a page that does not shrink is stored as it is
+    int length = lzCompress((const unsigned char *)memPage, (*mgmt).pageSize, (*map).packed, (*mgmt).pageSize - 1);
+    if (length == 0)
+    {
+        data = memPage;
+        length = (*mgmt).pageSize;
+    }
+
+    // rewrite in place while the page still fits its extent
+    SM_PageExtent *extent = &(*map).pages[pageNum];
+    int capacity = (length + SM_CZ_GRANULE - 1) / SM_CZ_GRANULE * SM_CZ_GRANULE;
+    if (capacity > (*extent).capacity)
+    {
+        if ((*extent).capacity > 0)
+            releaseExtent(map, extent);
+        (*extent).offset = allocExtent(map, capacity);
+        (*extent).capacity = capacity;
+    }
+
+    RC code = writeBytesAt((*mgmt).fd, (*extent).offset, data, length);
+    if (code == RC_OK)
+        (*extent).length = length;
+    return code;
+}
+
+// Write the header, the first page (stored uncompressed) and the page map of
+// a new compressed file whose other pages are zero pages
+static RC czCreate(const char *fileName, int pageSize, PageNumber numPages, const char *firstPage)
+{
+    char header[SM_CZ_HEADER_SIZE];
+    SM_CzHeader *h = (SM_CzHeader *)header;
+    SM_PageExtent *zeroPages = (SM_PageExtent *)calloc(numPages, sizeof(SM_PageExtent));
+
+    if (zeroPages == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    zeroPages[0].offset = SM_CZ_HEADER_SIZE;
+    zeroPages[0].length = pageSize;
+    zeroPages[0].capacity = pageSize;
+
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        free(zeroPages);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy((*h).magic, SM_CZ_MAGIC, sizeof((*h).magic));
+    (*h).numPages = numPages;
+    (*h).mapOffset = SM_CZ_HEADER_SIZE + pageSize;
+    (*h).pageSize = pageSize;
+
+    RC code = writeBytesAt(fd, 0, header, sizeof(header));
+    if (code == RC_OK)
+        code = writeBytesAt(fd, SM_CZ_HEADER_SIZE, firstPage, pageSize);
+    if (code == RC_OK)
+        code = writeBytesAt(fd, (*h).mapOffset, (const char *)zeroPages, numPages * sizeof(SM_PageExtent));
+
+    close(fd);
+    free(zeroPages);
+    return code;
+}
+
+static int cmpExtentOffset(const void *a, const void *b)
+{
+    int64_t oa = ((const SM_PageExtent *)a)->offset, ob = ((const SM_PageExtent *)b)->offset;
+    return (oa > ob) - (oa < ob);
+}
+
+// Make every gap between the extents of a freshly loaded map spare and end
+// the data after the last extent. Gaps are left by pages that moved to a
+// larger extent or were freed, and by the maps stored by syncPageFile.
+static RC czFindSpare(SM_PageMap *map)
+{
+    SM_PageExtent *used = (SM_PageExtent *)malloc(((*map).numPages + 1) * sizeof(SM_PageExtent));
+    PageNumber numUsed = 0;
+    int64_t end = SM_CZ_HEADER_SIZE;
+
+    if (used == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    for (PageNumber i = 0; i < (*map).numPages; i++)
+        if ((*map).pages[i].capacity > 0)
+            used[numUsed++] = (*map).pages[i];
+    qsort(used, numUsed, sizeof(SM_PageExtent), cmpExtentOffset);
+
+    for (PageNumber i = 0; i < numUsed; i++)
+    {
+        // an extent length is an int, so a large gap is kept in pieces
+        while (used[i].offset > end)
+        {
+            SM_PageExtent gap = {end, 0, (int32_t)(used[i].offset - end < (1 << 30) ? used[i].offset - end : (1 << 30))};
+            releaseExtent(map, &gap);
+            end += gap.capacity;
+        }
+        if (used[i].offset + used[i].capacity > end)
+            end = used[i].offset + used[i].capacity;
+    }
+    free(used);
+    (*map).dataEnd = end;
+    return RC_OK;
+}
+
+// Open a compressed file and load its page map
+static RC czOpen(const char *fileName, SM_FileMgmt *mgmt, PageNumber *numPages)
+{
+    SM_CzHeader h;
+    RC code = openDescriptor(fileName, mgmt);
+
+    if (code != RC_OK)
+        return code;
+
+    if (readBytesAt((*mgmt).fd, 0, (char *)&h, sizeof(h)) != RC_OK || memcmp(h.magic, SM_CZ_MAGIC, sizeof(h.magic)) != 0)
+        code = RC_IO_MODE_NOT_SUPPORTED; // not written in SM_IO_COMPRESSED mode
+
+    SM_PageMap *map = NULL;
+    if (code == RC_OK)
+    {
+        map = (SM_PageMap *)calloc(1, sizeof(SM_PageMap));
+        if (map == NULL || growPageMap(map, h.numPages) != RC_OK)
+            code = RC_MELLOC_MEM_ALLOC_FAILED;
+        else if (((*map).packed = (unsigned char *)malloc(h.pageSize)) == NULL)
+            code = RC_MELLOC_MEM_ALLOC_FAILED;
+    }
+    if (code == RC_OK && readBytesAt((*mgmt).fd, h.mapOffset, (char *)(*map).pages, h.numPages * sizeof(SM_PageExtent)) != RC_OK)
+        code = RC_FAILED;
+
+    // the map is rewritten on close, so its space is free for extents
+    if (code == RC_OK)
+        code = czFindSpare(map);
+
+    if (code != RC_OK)
+    {
+        if (map != NULL)
+        {
+            free((*map).pages);
+            free((*map).spare);
+            free((*map).packed);
+        }
+        free(map);
+        close((*mgmt).fd);
+        return code;
+    }
+
+    (*mgmt).pageMap = map;
+    (*mgmt).pageSize = h.pageSize;
+    *numPages = h.numPages;
+    return RC_OK;
+}
+
+// Store the page map after the last extent, then the header pointing to it
+static RC czWriteMap(SM_FileMgmt *mgmt)
+{
+    SM_PageMap *map = (*mgmt).pageMap;
+    char header[SM_CZ_HEADER_SIZE];
+    SM_CzHeader *h = (SM_CzHeader *)header;
+    size_t mapBytes = (*map).numPages * sizeof(SM_PageExtent);
+
+    memset(header, 0, sizeof(header));
+    memcpy((*h).magic, SM_CZ_MAGIC, sizeof((*h).magic));
+    (*h).numPages = (*map).numPages;
+    (*h).mapOffset = (*map).dataEnd;
+    (*h).pageSize = (*mgmt).pageSize;
+
+    RC code = writeBytesAt((*mgmt).fd, (*map).dataEnd, (const char *)(*map).pages, mapBytes);
+    if (code == RC_OK)
+        code = writeBytesAt((*mgmt).fd, 0, header, sizeof(header));
+    if (code == RC_OK && ftruncate((*mgmt).fd, (*map).dataEnd + mapBytes) != 0)
+        code = RC_WRITE_FAILED;
+    return code;
+}
+
+// The stored map has to stay valid until the next sync, so extents written
+// from now on go after it. Its space is reused once the file is opened again.
+static RC czSync(SM_FileMgmt *mgmt)
+{
+    RC code = czWriteMap(mgmt);
+    if (code == RC_OK && fdatasync((*mgmt).fd) != 0)
+        code = RC_WRITE_FAILED;
+    if (code == RC_OK)
+        (*mgmt).pageMap->dataEnd += (*mgmt).pageMap->numPages * sizeof(SM_PageExtent);
+    return code;
+}
+
+static RC czClose(SM_FileMgmt *mgmt)
+{
+    SM_PageMap *map = (*mgmt).pageMap;
+    RC code = czWriteMap(mgmt);
+
+    free((*map).pages);
+    free((*map).spare);
+    free((*map).packed);
+    free(map);
+    (*mgmt).pageMap = NULL;
+    diskClose(mgmt);
+    return code;
+}
+
+// New pages are zero pages in the map, they take no space
+static RC czGrow(SM_FileMgmt *mgmt, PageNumber numPages, PageNumber aheadPages)
+{
+    (void)aheadPages;
+    return growPageMap((*mgmt).pageMap, numPages);
+}
+
+static void czRelease(SM_FileMgmt *mgmt, PageNumber pageNum)
+{
+    SM_PageExtent *extent = &(*mgmt).pageMap->pages[pageNum];
+
+    if ((*extent).capacity > 0)
+        releaseExtent((*mgmt).pageMap, extent);
+    memset(extent, 0, sizeof(*extent));
+}
+
+// the page map is not shared with the async workers, requests complete inline
+static const SM_Backend compressedBackend = {
+    1, 0, czCreate, czOpen, czClose, diskDestroy,
+    compressedRead, compressedWrite, NULL, czGrow, czRelease, NULL, NULL, czSync};
+
+/************************************************************
+ *              in-memory page files                        *
+ ************************************************************/
+
+// SM_IO_MEMORY files live in a process wide list of named files that exist
+// until destroyPageFile (or the end of the process). Pages are allocated on
+// first write; a page never written reads as zeros.
+typedef struct SM_MemFile
+{
+    struct SM_MemFile *next;
+    char *name;
+    char **pages; // one page buffer per page, NULL for a zero page
+    PageNumber numPages, maxPages;
+    int pageSize;
+    int openCount;  // handles currently open on the file
+    int destroyed;  // destroyed while open, freed by the last close
+} SM_MemFile;
+
+static pthread_mutex_t memFilesLock = PTHREAD_MUTEX_INITIALIZER;
+static SM_MemFile *memFiles = NULL;
+
+// Find a file by name. Called with memFilesLock held.
+static SM_MemFile **findMemFile(const char *fileName)
+{
+    SM_MemFile **link = &memFiles;
+
+    while (*link != NULL && strcmp((**link).name, fileName) != 0)
+        link = &(**link).next;
+    return link;
+}
+
+static void truncateMemFile(SM_MemFile *file)
+{
+    for (PageNumber i = 0; i < (*file).numPages; i++)
+        freePageBuffer((*file).pages[i]);
+    (*file).numPages = 0;
+}
+
+static void freeMemFile(SM_MemFile *file)
+{
+    truncateMemFile(file);
+    free((*file).pages);
+    free((*file).name);
+    free(file);
+}
+
+static RC memGrow(SM_FileMgmt *mgmt, PageNumber numPages, PageNumber aheadPages)
+{
+    SM_MemFile *file = (*mgmt).memFile;
+
+    if (numPages > (*file).maxPages)
+    {
+        char **pages = (char **)realloc((*file).pages, aheadPages * sizeof(char *));
+        if (pages == NULL)
+            return RC_MELLOC_MEM_ALLOC_FAILED;
+        (*file).pages = pages;
+        (*file).maxPages = aheadPages;
+    }
+    for (; (*file).numPages < numPages; (*file).numPages++)
+        (*file).pages[(*file).numPages] = NULL;
+    return RC_OK;
+}
+
+static RC memCreate(const char *fileName, int pageSize, PageNumber numPages, const char *firstPage)
+{
+    SM_FileMgmt mgmt;
+    RC code = RC_OK;
+
+    pthread_mutex_lock(&memFilesLock);
+    SM_MemFile **link = findMemFile(fileName);
+    SM_MemFile *file = *link;
+
+    // like O_TRUNC, an existing file starts over
+    if (file != NULL)
+        truncateMemFile(file);
+    else
+    {
+        file = (SM_MemFile *)calloc(1, sizeof(SM_MemFile));
+        if (file == NULL || ((*file).name = strdup(fileName)) == NULL)
+        {
+            free(file);
+            pthread_mutex_unlock(&memFilesLock);
+            return RC_MELLOC_MEM_ALLOC_FAILED;
+        }
+        *link = file;
+    }
+
+    (*file).pageSize = pageSize;
+    mgmt.memFile = file;
+    code = memGrow(&mgmt, numPages, numPages);
+    if (code == RC_OK && ((*file).pages[0] = allocPageBufferOf(pageSize)) == NULL)
+        code = RC_MELLOC_MEM_ALLOC_FAILED;
+    if (code == RC_OK)
+        memcpy((*file).pages[0], firstPage, pageSize);
+    pthread_mutex_unlock(&memFilesLock);
+    return code;
+}
+
+static RC memOpen(const char *fileName, SM_FileMgmt *mgmt, PageNumber *numPages)
+{
+    pthread_mutex_lock(&memFilesLock);
+    SM_MemFile *file = *findMemFile(fileName);
+    if (file != NULL)
+    {
+        (*file).openCount++;
+        (*mgmt).memFile = file;
+        (*mgmt).pageSize = (*file).pageSize;
+        *numPages = (*file).numPages;
+    }
+    pthread_mutex_unlock(&memFilesLock);
+
+    return file != NULL ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+static RC memClose(SM_FileMgmt *mgmt)
+{
+    SM_MemFile *file = (*mgmt).memFile;
+
+    pthread_mutex_lock(&memFilesLock);
+    if (--(*file).openCount == 0 && (*file).destroyed)
+        freeMemFile(file);
+    pthread_mutex_unlock(&memFilesLock);
+    return RC_OK;
+}
+
+static RC memDestroy(const char *fileName)
+{
+    pthread_mutex_lock(&memFilesLock);
+    SM_MemFile **link = findMemFile(fileName);
+    SM_MemFile *file = *link;
+    if (file != NULL)
+    {
+        // the name is gone at once, the pages once the last handle closes
+        *link = (*file).next;
+        if ((*file).openCount > 0)
+            (*file).destroyed = 1;
+        else
+            freeMemFile(file);
+    }
+    pthread_mutex_unlock(&memFilesLock);
+
+    return file != NULL ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+static RC memRead(SM_FileMgmt *mgmt, PageNumber pageNum, char *memPage)
+{
+    SM_MemFile *file = (*mgmt).memFile;
+
+    if (pageNum >= (*file).numPages)
+        return RC_READ_NON_EXISTING_PAGE;
+    if ((*file).pages[pageNum] == NULL)
+        memset(memPage, 0, (*file).pageSize);
+    else
+        memcpy(memPage, (*file).pages[pageNum], (*file).pageSize);
+    return RC_OK;
+}
+
+static char *memPagePtr(SM_FileMgmt *mgmt, PageNumber pageNum)
+{
+    SM_MemFile *file = (*mgmt).memFile;
+
+    if ((*file).pages[pageNum] == NULL)
+        (*file).pages[pageNum] = allocPageBufferOf((*file).pageSize);
+    return (*file).pages[pageNum];
+}
+
+static RC memWrite(SM_FileMgmt *mgmt, PageNumber pageNum, const char *memPage)
+{
+    if (pageNum >= (*mgmt).memFile->numPages)
+        return RC_WRITE_NON_EXISTING_PAGE;
+
+    char *page = memPagePtr(mgmt, pageNum);
+    if (page == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    memcpy(page, memPage, (*mgmt).pageSize);
+    return RC_OK;
+}
+
+// nothing outlives the process anyway
+static RC memSync(SM_FileMgmt *mgmt)
+{
+    (void)mgmt;
+    return RC_OK;
+}
+
+static void memRelease(SM_FileMgmt *mgmt, PageNumber pageNum)
+{
+    SM_MemFile *file = (*mgmt).memFile;
+
+    freePageBuffer((*file).pages[pageNum]);
+    (*file).pages[pageNum] = NULL;
+}
+
+static const SM_Backend memoryBackend = {
+    1, 0, memCreate, memOpen, memClose, memDestroy,
+    memRead, memWrite, NULL, memGrow, memRelease, memPagePtr, NULL, memSync};
+
+// Backend for each SM_IOMode
+static const SM_Backend *backendFor(SM_IOMode mode)
+{
+    switch (mode)
+    {
+    case SM_IO_FILE:
+    case SM_IO_DIRECT:
+        return &fileBackend;
+    case SM_IO_MMAP:
+        return &mmapBackend;
+    case SM_IO_COMPRESSED:
+        return &compressedBackend;
+    case SM_IO_MEMORY:
+        return &memoryBackend;
+    }
+    return NULL;
+}
+
+// SM_IO_DIRECT moves pages straight between the device and the caller's
+// buffer, which therefore has to start on a PAGE_SIZE boundary
+static int misaligned(SM_FileMgmt *mgmt, const char *memPage)
+{
+    return (*mgmt).mode == SM_IO_DIRECT && ((uintptr_t)memPage % PAGE_SIZE) != 0;
+}
+
+/************************************************************
+ *              free-space map                              *
+ ************************************************************/
+
+// The first page of every group of fsmGroup + 1 physical pages is a bitmap
+// with one bit per following page of the group, set while that page is free
+// (see freePage/allocatePage). A zero bitmap, as left by file growth,
+// therefore marks every page as in use. The bitmap starts after
+// SM_FSM_HEADER_SIZE bytes, which hold the file header in the first bitmap
+// page. The bitmap pages are hidden from the callers: page numbers passed to
+// the interface are logical and skip them, while pageRead/pageWrite/
+// physTransferv work on physical pages.
+#define SM_FSM_HEADER_SIZE ((int)sizeof(SM_FileHeader))
+
+// Derive the page layout of a file from its page size
+static RC setPageLayout(SM_FileMgmt *mgmt, int pageSize)
+{
+    (*mgmt).pageSize = pageSize;
+    (*mgmt).pageCrc = pageCrcFor(pageSize);
+    (*mgmt).fsmGroup = (PageNumber)(PAGE_DATA_SIZE_OF(pageSize) - SM_FSM_HEADER_SIZE) * 8;
+    return (*mgmt).pageCrc != NULL ? RC_OK : RC_PAGE_SIZE_NOT_SUPPORTED;
+}
+
+static PageNumber physPage(SM_FileMgmt *mgmt, PageNumber pageNum)
+{
+    PageNumber group = (*mgmt).fsmGroup;
+    return (pageNum / group) * (group + 1) + 1 + pageNum % group;
+}
+
+// physical page holding the bitmap of the given group
+static PageNumber fsmPage(SM_FileMgmt *mgmt, PageNumber group)
+{
+    return group * ((*mgmt).fsmGroup + 1);
+}
+
+// physical pages needed to hold numPages logical pages
+static PageNumber physPageCount(SM_FileMgmt *mgmt, PageNumber numPages)
+{
+    return numPages + (numPages + (*mgmt).fsmGroup - 1) / (*mgmt).fsmGroup;
+}
+
+// logical pages held by numPhys physical pages
+static PageNumber logicalPageCount(SM_FileMgmt *mgmt, PageNumber numPhys)
+{
+    return numPhys - (numPhys + (*mgmt).fsmGroup) / ((*mgmt).fsmGroup + 1);
+}
+
+// Move one physical page from the file into memPage and check it
+static RC pageRead(SM_FileMgmt *mgmt, PageNumber pageNum, char *memPage)
+{
+    RC code = (*mgmt).backend->read(mgmt, pageNum, memPage);
+    return code == RC_OK ? verifyPage(mgmt, memPage) : code;
+}
+
+// Checksum memPage and move it into one physical page of the file
+static RC pageWrite(SM_FileMgmt *mgmt, PageNumber pageNum, char *memPage)
+{
+    (*mgmt).scanOnce = 0;
+    stampPage(mgmt, memPage);
+    return (*mgmt).backend->write(mgmt, pageNum, memPage);
+}
+
+// Move count consecutive physical pages starting at startPage, one buffer per page
+static RC physTransferv(SM_FileMgmt *mgmt, int write, PageNumber startPage, int count, SM_PageHandle *memPages)
+{
+    const SM_Backend *backend = (*mgmt).backend;
+    RC code = RC_OK;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (misaligned(mgmt, memPages[i]))
+            return RC_UNALIGNED_BUFFER;
+        if (write)
+            stampPage(mgmt, memPages[i]);
+    }
+
+    if ((*backend).transferv != NULL)
+        code = (*backend).transferv(mgmt, write, startPage, count, memPages);
+    else
+    {
+        for (int i = 0; i < count && code == RC_OK; i++)
+            code = write ? (*backend).write(mgmt, startPage + i, memPages[i]) : (*backend).read(mgmt, startPage + i, memPages[i]);
+    }
+
+    for (int i = 0; i < count && code == RC_OK && !write; i++)
+        code = verifyPage(mgmt, memPages[i]);
+    return code;
+}
+
+// Move count consecutive logical pages, one physical run per bitmap group
+static RC pageTransferv(SM_FileMgmt *mgmt, int write, PageNumber startPage, int count, SM_PageHandle *memPages)
+{
+    while (count > 0)
+    {
+        int len = (*mgmt).fsmGroup - startPage % (*mgmt).fsmGroup;
+        if (len > count)
+            len = count;
+
+        RC code = physTransferv(mgmt, write, physPage(mgmt, startPage), len, memPages);
+        if (code != RC_OK)
+            return code;
+        startPage += len;
+        memPages += len;
+        count -= len;
+    }
+    return RC_OK;
+}
+
+// Readahead: once SM_READAHEAD_TRIGGER pages have been read in a row, the
+// pages following the run are hinted to the OS so a forward scan finds them
+// cached instead of stalling on every read. The window doubles with the run
+// up to SM_READAHEAD_MAX pages and is topped up when half of it was consumed.
+// A file that was only scanned front to back once is dropped from the cache
+// when it is closed, so the scan does not push out pages that are reused.
+#define SM_READAHEAD_TRIGGER 4
+#define SM_READAHEAD_MAX 256
+
+// Record a read of count logical pages from startPage on an open file
+static void noteRead(SM_FileHandle *fHandle, PageNumber startPage, PageNumber count)
+{
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+
+    if (startPage == (*mgmt).nextRead)
+        (*mgmt).seqPages += count;
+    else
+    {
+        // the first read may start anywhere, any later jump ends the scan
+        if ((*mgmt).nextRead >= 0)
+            (*mgmt).scanOnce = 0;
+        (*mgmt).seqPages = count;
+        (*mgmt).aheadEnd = 0;
+    }
+    (*mgmt).nextRead = startPage + count;
+
+    if ((*mgmt).backend->advise == NULL || (*mgmt).seqPages < SM_READAHEAD_TRIGGER)
+        return;
+
+    PageNumber window = 2 * (*mgmt).seqPages;
+    if (window > SM_READAHEAD_MAX)
+        window = SM_READAHEAD_MAX;
+    if ((*mgmt).aheadEnd - (*mgmt).nextRead >= window / 2)
+        return;
+
+    PageNumber from = (*mgmt).aheadEnd > (*mgmt).nextRead ? (*mgmt).aheadEnd : (*mgmt).nextRead;
+    PageNumber to = (*mgmt).nextRead + window;
+    if (to > fHandle->totalNumPages)
+        to = fHandle->totalNumPages;
+    if (from >= to)
+        return;
+
+    PageNumber physFrom = physPage(mgmt, from);
+    (*mgmt).backend->advise(mgmt, physFrom, physPage(mgmt, to - 1) + 1 - physFrom, 1);
+    (*mgmt).aheadEnd = to;
+}
+
+// Pages reserved ahead of the end of a file that has to grow to numPages:
+// the file doubles, but never by more than growthChunkPages at once
+static PageNumber growthAhead(PageNumber numPages)
+{
+    return numPages < growthChunkPages ? numPages : growthChunkPages;
+}
+
+// Grow the file to numPages zero-filled pages, letting the backend reserve
+// room for growthAhead more
+static RC growFile(SM_FileHandle *fHandle, PageNumber numPages)
+{
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+
+    if (numPages <= fHandle->totalNumPages)
+        return RC_OK;
+
+    if ((*mgmt).backend->grow(mgmt, physPageCount(mgmt, numPages), physPageCount(mgmt, numPages + growthAhead(numPages))) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    fHandle->totalNumPages = numPages; // update total pages
+    return RC_OK;
+}
+
+// Count the pages marked free in the bitmaps of an opened file and pick up
+// the file header from the first of them
+static RC countFreePages(SM_FileHandle *fHandle)
+{
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+    PageNumber groups = (fHandle->totalNumPages + (*mgmt).fsmGroup - 1) / (*mgmt).fsmGroup;
+    SM_PageHandle bitmap = allocPageBufferOf((*mgmt).pageSize);
+
+    if (bitmap == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+
+    (*mgmt).freePages = 0;
+    for (PageNumber group = 0; group < groups; group++)
+    {
+        RC code = pageRead(mgmt, fsmPage(mgmt, group), bitmap);
+        if (code != RC_OK)
+        {
+            freePageBuffer(bitmap);
+            return code;
+        }
+        if (group == 0)
+            fHandle->fileId = (*(SM_FileHeader *)bitmap).fileId;
+        for (int i = SM_FSM_HEADER_SIZE; i < PAGE_DATA_SIZE_OF((*mgmt).pageSize); i++)
+            (*mgmt).freePages += __builtin_popcount((unsigned char)bitmap[i]);
+    }
+    freePageBuffer(bitmap);
+    return RC_OK;
+}
+
+extern void initStorageManager(void)
+{
+    // Nothing to set up: all per-file state lives in SM_FileHandle.mgmtInfo
+}
+
+extern void setIOMode(SM_IOMode mode)
+{
+    ioMode = mode;
+}
+
+extern SM_IOMode getIOMode(void)
+{
+    return ioMode;
+}
+
+extern RC setPageSize(int pageSize)
+{
+    if (pageCrcFor(pageSize) == NULL)
+        return RC_PAGE_SIZE_NOT_SUPPORTED;
+
+    filePageSize = pageSize;
+    return RC_OK;
+}
+
+extern int getPageSize(void)
+{
+    return filePageSize;
+}
+
+extern SM_PageHandle allocPageBuffer(void)
+{
+    return allocPageBufferOf(filePageSize);
+}
+
+extern SM_PageHandle allocPageBufferOf(int pageSize)
+{
+    void *memPage;
+
+    // page aligned so the buffer can be used with SM_IO_DIRECT files
+    if (posix_memalign(&memPage, PAGE_SIZE, pageSize) != 0)
+        return NULL;
+    memset(memPage, 0, pageSize);
+    return (SM_PageHandle)memPage;
+}
+
+extern void freePageBuffer(SM_PageHandle memPage)
+{
+    free(memPage);
+}
+
+extern void setGrowthPolicy(int maxChunkPages)
+{
+    growthChunkPages = maxChunkPages < 0 ? 0 : maxChunkPages;
+}
+
+static void freeAsyncCtx(SM_FileMgmt *mgmt);
+
+// An identifier unlikely to have been given to any other file
+static uint32_t newFileId(void)
+{
+    static uint32_t created = 0;
+    struct
+    {
+        struct timespec now;
+        pid_t pid;
+        uint32_t created;
+    } seed;
+
+    memset(&seed, 0, sizeof(seed));
+    clock_gettime(CLOCK_REALTIME, &seed.now);
+    seed.pid = getpid();
+    seed.created = __atomic_fetch_add(&created, 1, __ATOMIC_RELAXED);
+    return checksumBytes((const char *)&seed, sizeof(seed));
+}
+
+extern RC createPageFile(char *fileName)
+{
+    // Create a new page file fileName holding one page of '\0' bytes,
+    // preceded by the (empty) free-space bitmap of its group, which carries
+    // the file header
+    const SM_Backend *backend = backendFor(ioMode);
+    SM_FileMgmt layout;
+
+    if (backend == NULL)
+        return RC_IO_MODE_NOT_SUPPORTED;
+
+    setPageLayout(&layout, filePageSize);
+    SM_PageHandle first = allocPageBufferOf(filePageSize);
+    if (first == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+
+    SM_FileHeader *header = (SM_FileHeader *)first;
+    memcpy((*header).magic, SM_FILE_MAGIC, sizeof((*header).magic));
+    (*header).pageSize = filePageSize;
+    (*header).fileId = newFileId();
+    stampPage(&layout, first);
+
+    RC code = (*backend).create(fileName, filePageSize, physPageCount(&layout, 1), first);
+    freePageBuffer(first);
+    return code;
 }
 
 extern RC openPageFile(char *fileName, SM_FileHandle *fHandle)
 {
-    fptr = fopen(fileName, "r");
-
-    if (fptr == NULL)
-        return RC_FILE_NOT_FOUND;
+    const SM_Backend *backend = backendFor(ioMode);
+    PageNumber numPhys = 0;
+
+    if (backend == NULL)
+        return RC_IO_MODE_NOT_SUPPORTED;
+
+    SM_FileMgmt *mgmt = (SM_FileMgmt *)malloc(sizeof(SM_FileMgmt));
+    if (mgmt == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    (*mgmt).fd = -1;
+    (*mgmt).mode = ioMode;
+    (*mgmt).map = NULL;
+    (*mgmt).mapLen = 0;
+    (*mgmt).reserved = 0;
+    (*mgmt).freePages = 0;
+    (*mgmt).pageMap = NULL;
+    (*mgmt).memFile = NULL;
+    (*mgmt).backend = backend;
+    (*mgmt).async = NULL;
+    (*mgmt).nextRead = -1;
+    (*mgmt).seqPages = 0;
+    (*mgmt).aheadEnd = 0;
+    (*mgmt).scanOnce = 1;
+
+    RC code = (*backend).open(fileName, mgmt, &numPhys);
+    if (code != RC_OK)
+    {
+        free(mgmt);
+        return code;
+    }
 
     // set metadata of opened file
     fHandle->fileName = fileName; // set filename
     fHandle->curPagePos = 0;      // pointer should be point to 1st page in file
+    fHandle->mgmtInfo = mgmt;
 
-    // struct stat to obtain file size
-    struct stat fileinfo;
-    // success if 0, else -1
-    if (stat(fileName, &fileinfo) != 0)
-        return RC_FAILED;
-
-    fHandle->totalNumPages = (fileinfo.st_size / PAGE_SIZE); // may need to handle if file size is not a multiple of 1024
-
-    return RC_OK; // ok
+    // the page size the backend found decides where the pages are
+    code = setPageLayout(mgmt, (*mgmt).pageSize);
+    if (code == RC_OK)
+    {
+        fHandle->pageSize = (*mgmt).pageSize;
+        fHandle->totalNumPages = logicalPageCount(mgmt, numPhys);
+        code = countFreePages(fHandle);
+    }
+    if (code != RC_OK)
+        closePageFile(fHandle);
+    return code;
 }
 
 extern RC closePageFile(SM_FileHandle *fHandle)
 {
-    // May need to write the updated metadata into the file before closing the file
-    // or clear fHandle
-    // or this metadata may be handled differently under each function
-    if (fptr != NULL)
-        fptr = NULL;
-    return RC_OK;
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    // wait for outstanding asynchronous transfers before the descriptor goes away
+    if ((*mgmt).async != NULL)
+        freeAsyncCtx(mgmt);
+
+    // a file read once from front to back is not going to be needed again soon
+    if ((*mgmt).scanOnce && (*mgmt).seqPages >= SM_READAHEAD_TRIGGER && (*mgmt).backend->advise != NULL)
+        (*mgmt).backend->advise(mgmt, 0, physPageCount(mgmt, fHandle->totalNumPages), 0);
+
+    RC code = (*mgmt).backend->close(mgmt);
+    free(mgmt);
+    fHandle->mgmtInfo = NULL;
+    return code;
 }
 
 extern RC destroyPageFile(char *fileName)
 {
-    fptr = fopen(fileName, "r");
-    // check if file exists and is open
-    if (fptr == NULL)
-        return RC_FILE_NOT_FOUND;
-    // fclose(fptr);
+    const SM_Backend *backend = backendFor(ioMode);
 
-    // delete file
-    if (remove(fileName) != 0)
-        return RC_FAILED;
+    if (backend == NULL)
+        return RC_IO_MODE_NOT_SUPPORTED;
 
-    return RC_OK;
+    return (*backend).destroy(fileName);
 }
 
-extern RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+extern RC readBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     // check if pageNum is non-negative and is within range of existing pages
-    if ((pageNum < 0) || (pageNum > fHandle->totalNumPages))
+    if ((pageNum < 0) || (pageNum >= fHandle->totalNumPages))
         return RC_READ_NON_EXISTING_PAGE;
 
-    fptr = fopen(fHandle->fileName, "r");
-    if (fptr == NULL)
-        return RC_FILE_NOT_FOUND;
+    if (FILE_MGMT(fHandle) == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
 
-    // initiate memPage?
-    // memPage = (SM_PageHandle)malloc(PAGE_SIZE * sizeof(char));
+    if (misaligned(FILE_MGMT(fHandle), memPage))
+        return RC_UNALIGNED_BUFFER;
 
-    // set cursor to the page you want to read
-    if (fseek(fptr, (PAGE_SIZE * pageNum), SEEK_SET) != 0)
-        return RC_ERROR;
+    // read 1 page of data at the page's offset into memory pointed to by memPage
+    RC code = pageRead(FILE_MGMT(fHandle), physPage(FILE_MGMT(fHandle), pageNum), memPage);
+    if (code != RC_OK)
+        return code == RC_CHECKSUM_MISMATCH ? code : RC_FAILED;
 
-    // read 1 page of data from fptr and store it in memory pointed to by memPage
-    if (fread(memPage, sizeof(char), PAGE_SIZE, fptr) < PAGE_SIZE)
-        return RC_FAILED;
+    // update current page position in the metadata
+    fHandle->curPagePos = pageNum;
+    noteRead(fHandle, pageNum, 1);
+
+    return RC_OK;
+}
+
+extern RC getBlockPtr(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle *memPage)
+{
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+
+    if ((pageNum < 0) || (pageNum >= fHandle->totalNumPages))
+        return RC_READ_NON_EXISTING_PAGE;
 
-    // update current page number in the metadata
-    fHandle->curPagePos = ftell(fptr);
-    fclose(fptr);
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
 
+    // only mapped and in-memory files have a stable image to point into
+    if ((*mgmt).backend->pagePtr == NULL)
+        return RC_IO_MODE_NOT_SUPPORTED;
+
+    *memPage = (*mgmt).backend->pagePtr(mgmt, physPage(mgmt, pageNum));
+    if (*memPage == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    noteRead(fHandle, pageNum, 1);
+    return verifyPage(mgmt, *memPage);
+}
+
+extern RC readBlocks(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages)
+{
+    // the whole run has to lie inside the file
+    if (startPage < 0 || count < 0 || startPage + count > fHandle->totalNumPages)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    if (FILE_MGMT(fHandle) == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (count == 0)
+        return RC_OK;
+
+    RC code = pageTransferv(FILE_MGMT(fHandle), 0, startPage, count, memPages);
+    if (code != RC_OK)
+        return code == RC_UNALIGNED_BUFFER || code == RC_CHECKSUM_MISMATCH ? code : RC_FAILED;
+
+    fHandle->curPagePos = startPage + count - 1;
+    noteRead(fHandle, startPage, count);
     return RC_OK;
 }
 
-extern int getBlockPos(SM_FileHandle *fHandle)
+extern PageNumber getBlockPos(SM_FileHandle *fHandle)
 {
     // May need to handle negative values for curPagePos
     return fHandle->curPagePos;
@@ -138,10 +1848,10 @@ extern RC readPreviousBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 
     // check if there exists enough pages (there should be min 2 pages)
     // check if currentPagePos is not the first page or a negative number
-    if ((fHandle->totalNumPages < 2) || (fHandle->curPagePos < PAGE_SIZE))
+    if ((fHandle->totalNumPages < 2) || (fHandle->curPagePos < 1))
         return RC_READ_NON_EXISTING_PAGE;
 
-    return readBlock((fHandle->curPagePos / PAGE_SIZE) - 1, fHandle, memPage);
+    return readBlock(fHandle->curPagePos - 1, fHandle, memPage);
 }
 
 extern RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
@@ -153,7 +1863,7 @@ extern RC readCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
     if ((fHandle->totalNumPages < 1) || (fHandle->curPagePos < 0))
         return RC_READ_NON_EXISTING_PAGE;
 
-    readBlock((fHandle->curPagePos / PAGE_SIZE), fHandle, memPage);
+    return readBlock(fHandle->curPagePos, fHandle, memPage);
 }
 
 extern RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
@@ -162,10 +1872,10 @@ extern RC readNextBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
 
     // check if there exists enough pages (there should be atleast 2 pages)
     // check if currentPagePos is not the last page or a negative number
-    if ((fHandle->totalNumPages < 2) || ((fHandle->curPagePos / PAGE_SIZE) + 1) >= (fHandle->totalNumPages) || (fHandle->curPagePos < 0))
+    if ((fHandle->totalNumPages < 2) || (fHandle->curPagePos + 1) >= (fHandle->totalNumPages) || (fHandle->curPagePos < 0))
         return RC_READ_NON_EXISTING_PAGE;
 
-    return readBlock((fHandle->curPagePos / PAGE_SIZE) + 1, fHandle, memPage);
+    return readBlock(fHandle->curPagePos + 1, fHandle, memPage);
 }
 
 extern RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
@@ -180,113 +1890,779 @@ extern RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
     return readBlock(fHandle->totalNumPages - 1, fHandle, memPage);
 }
 
-extern RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
+extern RC writeBlock(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage)
 {
     // Checking if the pageNumber parameter is less than Total number of pages and less than 0, then return respective error code
     if (pageNum > fHandle->totalNumPages || pageNum < 0)
         return RC_WRITE_FAILED;
 
-    // Opening file stream in read & write mode
-    fptr = fopen(fHandle->fileName, "r+");
-
     // Checking if file was opened succesfully.
-    if (fptr == NULL)
-        return RC_FILE_NOT_FOUND;
+    if (FILE_MGMT(fHandle) == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (misaligned(FILE_MGMT(fHandle), memPage))
+        return RC_UNALIGNED_BUFFER;
+
+    // Writing one past the last page appends it to the file
+    if (pageNum == fHandle->totalNumPages && !FILE_MGMT(fHandle)->backend->writeExtends)
+    {
+        if (growFile(fHandle, pageNum + 1) != RC_OK)
+            return RC_WRITE_FAILED;
+    }
+
+    // Writing the entire page from memPage to its offset in the page file
+    if (pageWrite(FILE_MGMT(fHandle), physPage(FILE_MGMT(fHandle), pageNum), memPage) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    if (pageNum == fHandle->totalNumPages)
+        fHandle->totalNumPages++;
+
+    // Setting the current page position to the page written
+    fHandle->curPagePos = pageNum;
+    return RC_OK;
+}
+
+extern RC writeBlocks(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages)
+{
+    // the run may start at most one past the last page, like writeBlock
+    if (startPage < 0 || count < 0 || startPage > fHandle->totalNumPages)
+        return RC_WRITE_FAILED;
+
+    if (FILE_MGMT(fHandle) == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    if (count == 0)
+        return RC_OK;
+
+    // only a plain file grows by writing past its end, the others first make room
+    if (startPage + count > fHandle->totalNumPages && !FILE_MGMT(fHandle)->backend->writeExtends)
+    {
+        if (growFile(fHandle, startPage + count) != RC_OK)
+            return RC_WRITE_FAILED;
+    }
+
+    FILE_MGMT(fHandle)->scanOnce = 0;
+    RC code = pageTransferv(FILE_MGMT(fHandle), 1, startPage, count, memPages);
+    if (code != RC_OK)
+        return code == RC_UNALIGNED_BUFFER ? code : RC_WRITE_FAILED;
 
-    if (pageNum != 0)
+    if (startPage + count > fHandle->totalNumPages)
+        fHandle->totalNumPages = startPage + count;
+
+    fHandle->curPagePos = startPage + count - 1;
+    return RC_OK;
+}
+
+// page number and buffer of one entry of a scattered page list
+typedef struct SM_ListEntry
+{
+    PageNumber pageNum;
+    SM_PageHandle memPage;
+} SM_ListEntry;
+
+static int cmpListEntry(const void *a, const void *b)
+{
+    PageNumber pa = ((const SM_ListEntry *)a)->pageNum, pb = ((const SM_ListEntry *)b)->pageNum;
+    return (pa > pb) - (pa < pb);
+}
+
+// Sort a page list and transfer each run of adjacent pages with one call
+static RC transferBlockList(int write, PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages)
+{
+    RC code = RC_OK;
+
+    if (count <= 0)
+        return RC_OK;
+
+    SM_ListEntry *list = (SM_ListEntry *)malloc(count * sizeof(SM_ListEntry));
+    SM_PageHandle *run = (SM_PageHandle *)malloc(count * sizeof(SM_PageHandle));
+    if (list == NULL || run == NULL)
     {
-        // Writing data to the first page.
-        fHandle->curPagePos = PAGE_SIZE * pageNum;
-        fclose(fptr);
-        writeCurrentBlock(fHandle, memPage);
+        free(list);
+        free(run);
+        return RC_MELLOC_MEM_ALLOC_FAILED;
     }
 
-    // Check if the pageNum is the first page that needs to be written on
-    if (pageNum == 0)
+    for (int i = 0; i < count; i++)
     {
-        fseek(fptr, PAGE_SIZE * pageNum, SEEK_SET);
+        list[i].pageNum = pageNums[i];
+        list[i].memPage = memPages[i];
+    }
+    qsort(list, count, sizeof(SM_ListEntry), cmpListEntry);
 
-        // Writing the entire page from memPage to page file
-        if (fwrite(memPage, sizeof(char), PAGE_SIZE, fptr) < PAGE_SIZE)
+    for (int first = 0; first < count && code == RC_OK;)
+    {
+        int len = 1;
+        run[0] = list[first].memPage;
+        // extend the run while the next page follows directly
+        while (first + len < count && list[first + len].pageNum == list[first].pageNum + len)
         {
-            fclose(fptr);
-            return RC_WRITE_FAILED;
+            run[len] = list[first + len].memPage;
+            len++;
+        }
+
+        if (write)
+            code = writeBlocks(list[first].pageNum, len, fHandle, run);
+        else
+            code = readBlocks(list[first].pageNum, len, fHandle, run);
+        first += len;
+    }
+
+    free(run);
+    free(list);
+    return code;
+}
+
+extern RC readBlockList(PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages)
+{
+    return transferBlockList(0, pageNums, count, fHandle, memPages);
+}
+
+extern RC writeBlockList(PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages)
+{
+    return transferBlockList(1, pageNums, count, fHandle, memPages);
+}
+
+extern RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+{
+    // Writing memPage contents to the page at the current position
+    return writeBlock(fHandle->curPagePos, fHandle, memPage);
+}
+
+extern RC appendEmptyBlock(SM_FileHandle *fHandle)
+{
+    // WARN: not responsible for position where to insert
+    if (FILE_MGMT(fHandle) == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    // add one zero-filled page right after the last page
+    return growFile(fHandle, fHandle->totalNumPages + 1);
+}
+
+extern RC ensureCapacity(PageNumber numberOfPages, SM_FileHandle *fHandle)
+{
+    // Check if file opened successfully
+    if (FILE_MGMT(fHandle) == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    // Check if numberOfPages is greater than totalNumPages.
+    // If so, add empty pages till numberofPages is equal to the totalNumPages
+    if (numberOfPages <= fHandle->totalNumPages)
+        return RC_OK;
+
+    return growFile(fHandle, numberOfPages);
+}
+
+extern RC syncPageFile(SM_FileHandle *fHandle)
+{
+    if (FILE_MGMT(fHandle) == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    // asynchronous writes count once pollBlockCompletions returned them
+    return FILE_MGMT(fHandle)->backend->sync(FILE_MGMT(fHandle));
+}
+
+extern RC allocatePage(SM_FileHandle *fHandle, PageNumber *pageNum)
+{
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+    RC code = RC_OK;
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    // nothing to recycle: the file grows by one zero page
+    if ((*mgmt).freePages == 0)
+    {
+        if ((code = growFile(fHandle, fHandle->totalNumPages + 1)) != RC_OK)
+            return code;
+        *pageNum = fHandle->totalNumPages - 1;
+        return RC_OK;
+    }
+
+    SM_PageHandle bitmap = allocPageBufferOf((*mgmt).pageSize);
+    if (bitmap == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+
+    // take the lowest free page, keeping the file dense at its start
+    char *bits = bitmap + SM_FSM_HEADER_SIZE;
+    PageNumber groups = (fHandle->totalNumPages + (*mgmt).fsmGroup - 1) / (*mgmt).fsmGroup;
+    *pageNum = -1;
+    for (PageNumber group = 0; group < groups && *pageNum < 0 && code == RC_OK; group++)
+    {
+        if ((code = pageRead(mgmt, fsmPage(mgmt, group), bitmap)) != RC_OK)
+            break;
+        for (int i = 0; i < (*mgmt).fsmGroup / 8; i++)
+        {
+            if (bits[i] == 0)
+                continue;
+            int bit = __builtin_ctz((unsigned char)bits[i]);
+            bits[i] &= ~(1 << bit);
+            *pageNum = group * (*mgmt).fsmGroup + i * 8 + bit;
+            code = pageWrite(mgmt, fsmPage(mgmt, group), bitmap);
+            break;
+        }
+    }
+
+    // a recycled page is handed out zeroed, just like an appended one
+    if (code == RC_OK && *pageNum >= 0)
+    {
+        (*mgmt).freePages--;
+        memset(bitmap, 0, (*mgmt).pageSize);
+        code = pageWrite(mgmt, physPage(mgmt, *pageNum), bitmap);
+    }
+    freePageBuffer(bitmap);
+
+    if (code == RC_OK && *pageNum < 0)
+        return RC_FAILED; // the count disagrees with the bitmaps
+    return code;
+}
+
+extern RC freePage(SM_FileHandle *fHandle, PageNumber pageNum)
+{
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+
+    if ((pageNum < 0) || (pageNum >= fHandle->totalNumPages))
+        return RC_WRITE_NON_EXISTING_PAGE;
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    SM_PageHandle bitmap = allocPageBufferOf((*mgmt).pageSize);
+    if (bitmap == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+
+    char *bits = bitmap + SM_FSM_HEADER_SIZE;
+    PageNumber group = pageNum / (*mgmt).fsmGroup, bit = pageNum % (*mgmt).fsmGroup;
+    RC code = pageRead(mgmt, fsmPage(mgmt, group), bitmap);
+
+    // freeing a free page again changes nothing
+    if (code == RC_OK && !(bits[bit / 8] & (1 << (bit % 8))))
+    {
+        bits[bit / 8] |= 1 << (bit % 8);
+        code = pageWrite(mgmt, fsmPage(mgmt, group), bitmap);
+        if (code == RC_OK)
+        {
+            (*mgmt).freePages++;
+            (*mgmt).backend->release(mgmt, physPage(mgmt, pageNum));
         }
+    }
+    freePageBuffer(bitmap);
+    return code;
+}
+
+/************************************************************
+ *              asynchronous block I/O                      *
+ ************************************************************/
+
+// Transfers are submitted to a per-file io_uring when the kernel allows it and
+// otherwise queued to a small pool of worker threads shared by all files that
+// perform the blocking call. Either way, finished requests are collected on the
+// file's done list and handed back to the caller by pollBlockCompletions.
+
+#define SM_ASYNC_RING_ENTRIES 64
+#define SM_ASYNC_WORKERS 4
+
+typedef struct SM_AsyncReq
+{
+    struct SM_AsyncReq *next;
+    struct SM_AsyncCtx *ctx; // file the request belongs to
+    int write;               // 0 = read, 1 = write
+    PageNumber pageNum;             // first page of the run
+    int count;               // number of pages in the run
+    struct iovec *iov;       // one buffer per page, kept alive for the kernel
+    struct iovec iovOne;     // storage for iov when count == 1
+    void *tag;               // caller's token, returned in SM_Completion
+    RC rc;
+} SM_AsyncReq;
+
+typedef struct SM_AsyncCtx
+{
+    SM_FileMgmt *mgmt;
+    int inflight; // submitted requests not yet returned by pollBlockCompletions
+    SM_AsyncReq *doneHead, *doneTail;
+    pthread_mutex_t lock;
+    pthread_cond_t doneCond;
+
+    int ringFd; // -1 when io_uring is unavailable
+#ifdef SM_HAVE_IO_URING
+    unsigned ringEntries;
+    unsigned ringUsed; // SQEs submitted whose CQE has not been reaped
+    void *sqRing, *cqRing;
+    size_t sqRingLen, cqRingLen;
+    struct io_uring_sqe *sqes;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+#endif
+} SM_AsyncCtx;
+
+// worker-thread fallback, shared by all files
+static pthread_mutex_t workLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workCond = PTHREAD_COND_INITIALIZER;
+static SM_AsyncReq *workHead = NULL, *workTail = NULL;
+static int workersStarted = 0;
+
+// Hand a finished request to its file's done list
+static void completeAsyncReq(SM_AsyncReq *req)
+{
+    SM_AsyncCtx *ctx = (*req).ctx;
+
+    pthread_mutex_lock(&(*ctx).lock);
+    (*req).next = NULL;
+    if ((*ctx).doneTail != NULL)
+        (*ctx).doneTail->next = req;
+    else
+        (*ctx).doneHead = req;
+    (*ctx).doneTail = req;
+    pthread_cond_broadcast(&(*ctx).doneCond);
+    pthread_mutex_unlock(&(*ctx).lock);
+}
+
+// Perform a request with the blocking page functions
+static void runAsyncReq(SM_AsyncReq *req)
+{
+    SM_FileMgmt *mgmt = (*req).ctx->mgmt;
+
+    SM_PageHandle pages[(*req).count];
+
+    for (int i = 0; i < (*req).count; i++)
+        pages[i] = (*req).iov[i].iov_base;
+    (*req).rc = pageTransferv(mgmt, (*req).write, (*req).pageNum, (*req).count, pages);
+    completeAsyncReq(req);
+}
 
-        // Setting the current page position to the cursor(pointer) position of the file stream
-        fHandle->curPagePos = ftell(fptr);
+static void *asyncWorker(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&workLock);
+        while (workHead == NULL)
+            pthread_cond_wait(&workCond, &workLock);
+        SM_AsyncReq *req = workHead;
+        workHead = (*req).next;
+        if (workHead == NULL)
+            workTail = NULL;
+        pthread_mutex_unlock(&workLock);
+
+        runAsyncReq(req);
+    }
+    return NULL;
+}
 
-        // Closing file stream so that all the buffers are flushed.
-        fclose(fptr);
+static RC queueToWorkers(SM_AsyncReq *req)
+{
+    pthread_mutex_lock(&workLock);
+    if (!workersStarted)
+    {
+        for (int i = 0; i < SM_ASYNC_WORKERS; i++)
+        {
+            pthread_t tid;
+            if (pthread_create(&tid, NULL, asyncWorker, NULL) != 0)
+                break;
+            pthread_detach(tid);
+            workersStarted++;
+        }
+        if (!workersStarted)
+        {
+            pthread_mutex_unlock(&workLock);
+            return RC_FAILED;
+        }
     }
+    (*req).next = NULL;
+    if (workTail != NULL)
+        workTail->next = req;
+    else
+        workHead = req;
+    workTail = req;
+    pthread_cond_signal(&workCond);
+    pthread_mutex_unlock(&workLock);
     return RC_OK;
 }
 
-extern RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage)
+#ifdef SM_HAVE_IO_URING
+// Set up a ring for the file; leaves ringFd at -1 if the kernel refuses
+static void setupRing(SM_AsyncCtx *ctx)
 {
-    // Opening file stream in read & write mode
-    fptr = fopen(fHandle->fileName, "r+");
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
 
-    // Checking if file was opened succesfully.
-    if (fptr == NULL)
-        return RC_FILE_NOT_FOUND;
+    int fd = syscall(__NR_io_uring_setup, SM_ASYNC_RING_ENTRIES, &p);
+    if (fd < 0)
+        return;
+
+    (*ctx).sqRingLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    (*ctx).cqRingLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if ((*ctx).cqRingLen > (*ctx).sqRingLen)
+            (*ctx).sqRingLen = (*ctx).cqRingLen;
+        (*ctx).cqRingLen = (*ctx).sqRingLen;
+    }
+
+    (*ctx).sqRing = mmap(NULL, (*ctx).sqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if ((*ctx).sqRing == MAP_FAILED)
+    {
+        close(fd);
+        return;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        (*ctx).cqRing = (*ctx).sqRing;
+    else
+    {
+        (*ctx).cqRing = mmap(NULL, (*ctx).cqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if ((*ctx).cqRing == MAP_FAILED)
+        {
+            munmap((*ctx).sqRing, (*ctx).sqRingLen);
+            close(fd);
+            return;
+        }
+    }
+    (*ctx).sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if ((*ctx).sqes == MAP_FAILED)
+    {
+        if ((*ctx).cqRing != (*ctx).sqRing)
+            munmap((*ctx).cqRing, (*ctx).cqRingLen);
+        munmap((*ctx).sqRing, (*ctx).sqRingLen);
+        close(fd);
+        return;
+    }
+
+    char *sq = (*ctx).sqRing, *cq = (*ctx).cqRing;
+    (*ctx).sqHead = (unsigned *)(sq + p.sq_off.head);
+    (*ctx).sqTail = (unsigned *)(sq + p.sq_off.tail);
+    (*ctx).sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+    (*ctx).sqArray = (unsigned *)(sq + p.sq_off.array);
+    (*ctx).cqHead = (unsigned *)(cq + p.cq_off.head);
+    (*ctx).cqTail = (unsigned *)(cq + p.cq_off.tail);
+    (*ctx).cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+    (*ctx).cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    (*ctx).ringEntries = p.sq_entries;
+    (*ctx).ringUsed = 0;
+    (*ctx).ringFd = fd;
+}
 
-    // Appending an empty block ensure there is space for the new content.
-    appendEmptyBlock(fHandle);
+static void teardownRing(SM_AsyncCtx *ctx)
+{
+    munmap((*ctx).sqes, (*ctx).ringEntries * sizeof(struct io_uring_sqe));
+    if ((*ctx).cqRing != (*ctx).sqRing)
+        munmap((*ctx).cqRing, (*ctx).cqRingLen);
+    munmap((*ctx).sqRing, (*ctx).sqRingLen);
+    close((*ctx).ringFd);
+    (*ctx).ringFd = -1;
+}
 
-    // Setting pointer position in file
-    fseek(fptr, fHandle->curPagePos, SEEK_SET);
+// Move every available CQE to the done list. Called with ctx->lock held.
+static void reapRing(SM_AsyncCtx *ctx)
+{
+    unsigned head = *(*ctx).cqHead;
+    unsigned tail = __atomic_load_n((*ctx).cqTail, __ATOMIC_ACQUIRE);
 
-    // Writing memPage contents to the file.
-    if(fwrite(memPage, sizeof(char), strlen(memPage), fptr) < PAGE_SIZE){
-        fclose(fptr);
-        return RC_WRITE_FAILED;
+    for (; head != tail; head++)
+    {
+        struct io_uring_cqe *cqe = &(*ctx).cqes[head & *(*ctx).cqMask];
+        SM_AsyncReq *req = (SM_AsyncReq *)(uintptr_t)(*cqe).user_data;
+
+        int done = (*req).count;
+
+        if ((*cqe).res < 0)
+            (*req).rc = (*req).write ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        else if ((*cqe).res < (*req).count * (*ctx).mgmt->pageSize)
+        {
+            // a short transfer is no error, the remaining pages are moved
+            // synchronously from the first one the kernel did not finish
+            SM_PageHandle pages[(*req).count];
+
+            done = (*cqe).res / (*ctx).mgmt->pageSize;
+            for (int i = done; i < (*req).count; i++)
+                pages[i] = (*req).iov[i].iov_base;
+            (*req).rc = pageTransferv((*ctx).mgmt, (*req).write, (*req).pageNum + done,
+                                      (*req).count - done, &pages[done]);
+        }
+        else
+            (*req).rc = RC_OK;
+
+        // pageTransferv verified the pages it read itself
+        for (int i = 0; i < done && (*req).rc == RC_OK && !(*req).write; i++)
+            (*req).rc = verifyPage((*ctx).mgmt, (*req).iov[i].iov_base);
+
+        (*req).next = NULL;
+        if ((*ctx).doneTail != NULL)
+            (*ctx).doneTail->next = req;
+        else
+            (*ctx).doneHead = req;
+        (*ctx).doneTail = req;
+        (*ctx).ringUsed--;
     }
+    __atomic_store_n((*ctx).cqHead, head, __ATOMIC_RELEASE);
+}
 
-    // Setting the current page position to the cursor(pointer) position of the fHandle
-    fHandle->curPagePos = ftell(fptr);
+// Queue one SQE for the request and start it. Called with ctx->lock held.
+static RC submitToRing(SM_AsyncCtx *ctx, SM_AsyncReq *req)
+{
+    // the ring is full: wait for the kernel to finish something first
+    while ((*ctx).ringUsed >= (*ctx).ringEntries)
+    {
+        if (syscall(__NR_io_uring_enter, (*ctx).ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+            return RC_FAILED;
+        reapRing(ctx);
+    }
 
-    fclose(fptr);
+    unsigned tail = *(*ctx).sqTail;
+    unsigned idx = tail & *(*ctx).sqMask;
+    struct io_uring_sqe *sqe = &(*ctx).sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    (*sqe).opcode = (*req).write ? IORING_OP_WRITEV : IORING_OP_READV;
+    (*sqe).fd = (*ctx).mgmt->fd;
+    (*sqe).off = (off_t)(*ctx).mgmt->pageSize * physPage((*ctx).mgmt, (*req).pageNum);
+    (*sqe).addr = (uintptr_t)(*req).iov;
+    (*sqe).len = (*req).count;
+    (*sqe).user_data = (uintptr_t)req;
+    (*ctx).sqArray[idx] = idx;
+    __atomic_store_n((*ctx).sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    for (;;)
+    {
+        int n = syscall(__NR_io_uring_enter, (*ctx).ringFd, 1, 0, 0, NULL, 0);
+        if (n >= 0)
+            break;
+        if (errno != EINTR)
+        {
+            // take the SQE back, the kernel never saw it
+            __atomic_store_n((*ctx).sqTail, tail, __ATOMIC_RELEASE);
+            return RC_FAILED;
+        }
+    }
+    (*ctx).ringUsed++;
     return RC_OK;
 }
+#endif
 
-extern RC appendEmptyBlock(SM_FileHandle *fHandle)
+static SM_AsyncCtx *getAsyncCtx(SM_FileMgmt *mgmt)
 {
-    // TODO: create new page
-    // WARN: not responsible for position where to insert
+    if ((*mgmt).async != NULL)
+        return (*mgmt).async;
+
+    SM_AsyncCtx *ctx = (SM_AsyncCtx *)calloc(1, sizeof(SM_AsyncCtx));
+    if (ctx == NULL)
+        return NULL;
+    (*ctx).mgmt = mgmt;
+    (*ctx).ringFd = -1;
+    pthread_mutex_init(&(*ctx).lock, NULL);
+    pthread_cond_init(&(*ctx).doneCond, NULL);
+
+#ifdef SM_HAVE_IO_URING
+    // the ring only helps plain descriptor I/O
+    if (!(*mgmt).backend->inMemory)
+        setupRing(ctx);
+#endif
+
+    (*mgmt).async = ctx;
+    return ctx;
+}
+
+static void freeAsyncCtx(SM_FileMgmt *mgmt)
+{
+    SM_AsyncCtx *ctx = (*mgmt).async;
+    SM_Completion done[SM_ASYNC_RING_ENTRIES];
+    SM_FileHandle fh;
+
+    // drain whatever the caller left in flight
+    fh.mgmtInfo = mgmt;
+    while ((*ctx).inflight > 0)
+        pollBlockCompletions(&fh, done, 1, SM_ASYNC_RING_ENTRIES);
+
+#ifdef SM_HAVE_IO_URING
+    if ((*ctx).ringFd >= 0)
+        teardownRing(ctx);
+#endif
+    pthread_cond_destroy(&(*ctx).doneCond);
+    pthread_mutex_destroy(&(*ctx).lock);
+    free(ctx);
+    (*mgmt).async = NULL;
+}
+
+// Release a request and its buffer list
+static void freeAsyncReq(SM_AsyncReq *req)
+{
+    if ((*req).iov != &(*req).iovOne)
+        free((*req).iov);
+    free(req);
+}
+
+static RC submitBlockAsync(int write, PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages, void *tag)
+{
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+    RC code = RC_OK;
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (misaligned(mgmt, memPages[i]))
+            return RC_UNALIGNED_BUFFER;
+    }
+
+    SM_AsyncCtx *ctx = getAsyncCtx(mgmt);
+    if (ctx == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+
+    // asynchronous reads are issued ahead on purpose and are left out of
+    // the sequential detection, writes end a read-once scan
+    if (write)
+        (*mgmt).scanOnce = 0;
+
+    SM_AsyncReq *req = (SM_AsyncReq *)malloc(sizeof(SM_AsyncReq));
+    if (req == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    (*req).ctx = ctx;
+    (*req).write = write;
+    (*req).pageNum = startPage;
+    (*req).count = count;
+    (*req).iov = count == 1 ? &(*req).iovOne : (struct iovec *)malloc(count * sizeof(struct iovec));
+    if ((*req).iov == NULL)
+    {
+        free(req);
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        (*req).iov[i].iov_base = memPages[i];
+        (*req).iov[i].iov_len = (*mgmt).pageSize;
+    }
+    (*req).tag = tag;
+    (*req).rc = RC_OK;
+
+    pthread_mutex_lock(&(*ctx).lock);
+    (*ctx).inflight++;
+#ifdef SM_HAVE_IO_URING
+    // a single SQE can carry at most IOV_MAX buffers and has to stay clear
+    // of the free-space bitmaps
+    if ((*ctx).ringFd >= 0 && count <= IOV_MAX && startPage % (*mgmt).fsmGroup + count <= (*mgmt).fsmGroup)
+    {
+        // the workers stamp in pageTransferv, the kernel needs it done here
+        for (int i = 0; i < count && write; i++)
+            stampPage(mgmt, memPages[i]);
+        code = submitToRing(ctx, req);
+        if (code != RC_OK)
+            (*ctx).inflight--;
+        pthread_mutex_unlock(&(*ctx).lock);
+        if (code != RC_OK)
+            freeAsyncReq(req);
+        return code;
+    }
+#endif
+    pthread_mutex_unlock(&(*ctx).lock);
+
+    // a memory copy (or the compressed page map, which is not shared with
+    // the workers) is finished right away
+    if ((*mgmt).backend->inMemory)
+    {
+        runAsyncReq(req);
+        return RC_OK;
+    }
+
+    code = queueToWorkers(req);
+    if (code != RC_OK)
+    {
+        pthread_mutex_lock(&(*ctx).lock);
+        (*ctx).inflight--;
+        pthread_mutex_unlock(&(*ctx).lock);
+        freeAsyncReq(req);
+    }
+    return code;
+}
+
+extern RC readBlockAsync(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag)
+{
+    // check if pageNum is non-negative and is within range of existing pages
+    if ((pageNum < 0) || (pageNum >= fHandle->totalNumPages))
+        return RC_READ_NON_EXISTING_PAGE;
+
+    return submitBlockAsync(0, pageNum, 1, fHandle, &memPage, tag);
+}
 
-    // Create a page and fill it with '\0' bytes
-    SM_PageHandle page = (SM_PageHandle)malloc(PAGE_SIZE * sizeof(char));
-    memset(page, 0, PAGE_SIZE); // set all bytes in page to '\0'
+extern RC writeBlockAsync(PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag)
+{
+    return writeBlocksAsync(pageNum, 1, fHandle, &memPage, tag);
+}
+
+extern RC readBlocksAsync(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages, void *tag)
+{
+    // the whole run has to lie inside the file
+    if (startPage < 0 || count < 1 || startPage + count > fHandle->totalNumPages)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    return submitBlockAsync(0, startPage, count, fHandle, memPages, tag);
+}
 
-    // set pointer to the newly appended page
-    int pos = (fHandle->totalNumPages) * PAGE_SIZE;
-    fseek(fptr, pos, SEEK_SET);
-    // write page bytes into file
-    if (fwrite(page, sizeof(char), PAGE_SIZE, fptr) < PAGE_SIZE)
+extern RC writeBlocksAsync(PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages, void *tag)
+{
+    if (startPage < 0 || count < 1 || startPage > fHandle->totalNumPages)
         return RC_WRITE_FAILED;
 
-    free(page);               // dispose memory
-    fHandle->totalNumPages++; // update total pages
+    if (FILE_MGMT(fHandle) == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
 
-    return RC_OK; // ok
+    // appending: extend the file now so the page count is right on return
+    if (startPage + count > fHandle->totalNumPages && growFile(fHandle, startPage + count) != RC_OK)
+        return RC_WRITE_FAILED;
+
+    return submitBlockAsync(1, startPage, count, fHandle, memPages, tag);
 }
 
-extern RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle)
+extern int pollBlockCompletions(SM_FileHandle *fHandle, SM_Completion *done, int minDone, int maxDone)
 {
-    // Opening file stream in append mode.
-    fptr = fopen(fHandle->fileName, "a");
+    SM_FileMgmt *mgmt = FILE_MGMT(fHandle);
+    int count = 0;
 
-    // Check if file opened successfully
-    if (fptr == NULL)
-        return RC_FILE_NOT_FOUND;
+    if (mgmt == NULL || (*mgmt).async == NULL)
+        return 0;
 
-    // Check if numberOfPages is greater than totalNumPages.
-    // If so, add empty pages till numberofPages is equal to the totalNumPages
-    for (; numberOfPages > fHandle->totalNumPages;)
-        appendEmptyBlock(fHandle);
+    SM_AsyncCtx *ctx = (*mgmt).async;
+    pthread_mutex_lock(&(*ctx).lock);
 
-    // Closing file stream so that all the buffers are flushed.
-    fclose(fptr);
-    return RC_OK;
+    // never wait for more than is actually outstanding
+    if (minDone > (*ctx).inflight)
+        minDone = (*ctx).inflight;
+    if (minDone > maxDone)
+        minDone = maxDone;
+
+    for (;;)
+    {
+#ifdef SM_HAVE_IO_URING
+        if ((*ctx).ringFd >= 0)
+            reapRing(ctx);
+#endif
+        for (; count < maxDone && (*ctx).doneHead != NULL; count++)
+        {
+            SM_AsyncReq *req = (*ctx).doneHead;
+            (*ctx).doneHead = (*req).next;
+            if ((*ctx).doneHead == NULL)
+                (*ctx).doneTail = NULL;
+            done[count].tag = (*req).tag;
+            done[count].rc = (*req).rc;
+            (*ctx).inflight--;
+            freeAsyncReq(req);
+        }
+        if (count >= minDone)
+            break;
+
+#ifdef SM_HAVE_IO_URING
+        // wait on the ring only while it has work, oversized runs go to the workers
+        if ((*ctx).ringFd >= 0 && (*ctx).ringUsed > 0)
+        {
+            pthread_mutex_unlock(&(*ctx).lock);
+            syscall(__NR_io_uring_enter, (*ctx).ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            pthread_mutex_lock(&(*ctx).lock);
+            continue;
+        }
+#endif
+        pthread_cond_wait(&(*ctx).doneCond, &(*ctx).lock);
+    }
+
+    pthread_mutex_unlock(&(*ctx).lock);
+    return count;
 }
@@ -8,36 +8,110 @@
  ************************************************************/
 typedef struct SM_FileHandle {
   char *fileName;
-  int totalNumPages;
-  int curPagePos;
+  PageNumber totalNumPages;
+  PageNumber curPagePos; // page last read or written
+  int pageSize; // bytes per page, fixed when the file was created
+  unsigned int fileId; // random number given to the file by createPageFile
+
   void *mgmtInfo;
 } SM_FileHandle;
 
 typedef char* SM_PageHandle;
 
+/* page sizes a page file can be created with; X is expanded once per size
+ * so code can be specialised with a constant page size */
+#define SM_PAGE_SIZES(X) X(4096) X(8192) X(16384) X(32768) X(65536)
+
+/* default largest number of pages reserved ahead of a growing file (8 MB) */
+#define SM_DEFAULT_GROWTH_CHUNK 2048
+
+/* storage backend used by createPageFile, openPageFile and destroyPageFile,
+ * and how it moves pages between the file and memory */
+typedef enum SM_IOMode {
+  SM_IO_FILE = 0,   // positioned pread/pwrite on a descriptor (default)
+  SM_IO_MMAP = 1,   // whole file mapped, pages copied with memcpy
+  SM_IO_DIRECT = 2, // O_DIRECT, bypasses the OS page cache; every page
+                    // buffer must be page aligned (see allocPageBuffer)
+  SM_IO_COMPRESSED = 3, // pages LZ-compressed into variable size extents; the
+                        // file must have been created in this mode
+  SM_IO_MEMORY = 4 // files kept in RAM by name until destroyPageFile, for
+                   // temporary tables and tests without disk I/O
+} SM_IOMode;
+
+/* result of an asynchronous transfer, see pollBlockCompletions */
+typedef struct SM_Completion {
+  void *tag; // token passed to readBlockAsync/writeBlockAsync
+  RC rc;     // outcome of the transfer
+} SM_Completion;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
 /* manipulating page files */
 extern void initStorageManager (void);
+extern void setIOMode (SM_IOMode mode); /* applies to files created or opened afterwards */
+extern SM_IOMode getIOMode (void);
+/* growing files reserve as many pages again as they hold, capped at
+ * maxChunkPages per step; 0 turns reservation off */
+extern void setGrowthPolicy (int maxChunkPages);
+/* page size of files created from now on (PAGE_SIZE by default); opened
+ * files keep the size they were created with, see SM_FileHandle.pageSize */
+extern RC setPageSize (int pageSize);
+extern int getPageSize (void);
+
+/* zeroed, page aligned page buffers usable with every I/O mode; allocPageBuffer
+ * sizes them for the current page size, allocPageBufferOf for a given one */
+extern SM_PageHandle allocPageBuffer (void);
+extern SM_PageHandle allocPageBufferOf (int pageSize);
+extern void freePageBuffer (SM_PageHandle memPage);
+/* CRC32C of len bytes, as stored in the page trailers */
+extern unsigned int checksumBytes (const char *data, int len);
 extern RC createPageFile (char *fileName);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
 
-/* reading blocks from disc */
-extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
-extern int getBlockPos (SM_FileHandle *fHandle);
+/* reading blocks from disc; the *Blocks forms move count consecutive pages
+ * with one vectored call, the *BlockList forms take pages in any order and
+ * merge adjacent ones into such runs. A page whose CRC32C trailer does not
+ * match its contents is reported as RC_CHECKSUM_MISMATCH. */
+extern RC readBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+/* SM_IO_MMAP and SM_IO_MEMORY only: point memPage at the stored page instead
+ * of copying it. The pointer is valid until the file grows or is closed. */
+extern RC getBlockPtr (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle *memPage);
+extern RC readBlocks (PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+extern RC readBlockList (PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+extern PageNumber getBlockPos (SM_FileHandle *fHandle);
 extern RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 
-/* writing blocks to a page file */
-extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+/* writing blocks to a page file; the CRC32C trailer (the last
+ * PAGE_CHECKSUM_SIZE bytes) is stamped into memPage before it is written */
+extern RC writeBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlocks (PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+extern RC writeBlockList (PageNumber *pageNums, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
-extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC ensureCapacity (PageNumber numberOfPages, SM_FileHandle *fHandle);
+/* make every page written so far survive a crash (fdatasync) */
+extern RC syncPageFile (SM_FileHandle *fHandle);
+
+/* page recycling: freePage marks a page free in the file's free-space map
+ * and releases its disk space, allocatePage hands out the lowest free page
+ * (zero-filled) and only appends a new page when none is free */
+extern RC allocatePage (SM_FileHandle *fHandle, PageNumber *pageNum);
+extern RC freePage (SM_FileHandle *fHandle, PageNumber pageNum);
+
+/* asynchronous block I/O: memPage must stay untouched until the transfer is
+ * returned by pollBlockCompletions, which blocks until at least minDone
+ * transfers have finished and returns how many were stored in done */
+extern RC readBlockAsync (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag);
+extern RC writeBlockAsync (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage, void *tag);
+extern RC readBlocksAsync (PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages, void *tag);
+extern RC writeBlocksAsync (PageNumber startPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages, void *tag);
+extern int pollBlockCompletions (SM_FileHandle *fHandle, SM_Completion *done, int minDone, int maxDone);
 
 #endif
@@ -2,6 +2,7 @@
 #define TABLES_H
 
 #include "dt.h"
+#include "dberror.h"
 
 // Data Types, Records, and Schemas
 typedef enum DataType {
@@ -22,7 +23,7 @@ typedef struct Value {
 } Value;
 
 typedef struct RID {
-	int page;
+	PageNumber page;
 	int slot;
 } RID;
 
@@ -0,0 +1,858 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// markDirty calls per round of the checkpoint test, about 20 MB of log
+#define LOG_ROUND_PAGES 5000
+// checkpoints keep the log of a pool near 16 MB
+#define LOG_LIMIT (24 * 1024 * 1024)
+
+// threads of the stress test, each one the only writer of every
+// STRESS_THREADS-th page, and the pins each of them makes
+#define STRESS_THREADS 8
+#define STRESS_PAGES 64
+#define STRESS_PINS 20000
+
+typedef struct StressWorker {
+	BM_BufferPool *bm;
+	int id;
+	int *updates;   // updates made to each page, by its writer
+	int failures;   // calls that did not return RC_OK or pages that held the wrong data
+} StressWorker;
+
+// threads pinning pages of an LFU pool at the same moment, the pins each
+// makes, and the times they do; the pool ages its counts only after 8 pins
+// per frame, more than the test makes
+#define HIT_THREADS 8
+#define HIT_FRAMES 64
+#define HIT_PINS 40
+#define HIT_ROUNDS 20
+
+// frames of the flusher test, and how long it waits for the flusher
+#define FLUSH_FRAMES 20
+#define FLUSH_WAIT_MS 5000
+
+// pages of the prefetch test
+#define PREFETCH_PAGES 8
+
+typedef struct HitWorker {
+	BM_BufferPool *bm;
+	int id;
+	pthread_barrier_t *start;
+	int failures;
+} HitWorker;
+
+// test methods
+static void testLogCheckpoint (void);
+static void testLRU (void);
+static void testClock (void);
+static void testLFU (void);
+static void testLRUK (void);
+static void testARC (void);
+static void test2Q (void);
+static void testTwoPools (void);
+static void testConcurrentPins (void);
+static void testConcurrentHits (void);
+static void testFlusher (void);
+static void testPrefetch (void);
+static void testPastEndOfFile (void);
+
+// helpers
+static void makePageFile (char *fileName, int numPages);
+static void usePage (BM_BufferPool *bm, BM_PageHandle *h, PageNumber pageNum);
+static void checkPool (BM_BufferPool *bm, char *expected, char *message);
+static void *stressPool (void *arg);
+static void *hitPage (void *arg);
+static int waitForDirty (BM_BufferPool *bm, int maxDirty);
+
+char *testName;
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	initStorageManager();
+
+	testLogCheckpoint();
+	testLRU();
+	testClock();
+	testLFU();
+	testLRUK();
+	testARC();
+	test2Q();
+	testTwoPools();
+	testConcurrentPins();
+	testConcurrentHits();
+	testFlusher();
+	testPrefetch();
+	testPastEndOfFile();
+
+	return 0;
+}
+
+// ************************************************************
+void
+testLogCheckpoint (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	struct stat st;
+	char expected[64];
+
+	testName = "test log checkpoints";
+
+	TEST_CHECK(createPageFile("testbuffer.bin"));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_LRU, NULL));
+
+	// every round logs more than a checkpoint lets the log hold
+	for (int round = 0; round < 4; round++)
+	{
+		for (int i = 0; i < LOG_ROUND_PAGES; i++)
+		{
+			TEST_CHECK(pinPage(bm, h, i % 50));
+			sprintf(h->data, "round %d page %d", round, i % 50);
+			TEST_CHECK(markDirty(bm, h));
+			TEST_CHECK(unpinPage(bm, h));
+		}
+		TEST_CHECK(forceFlushPool(bm));
+		// in-memory page files keep no log
+		ASSERT_TRUE(getIOMode() == SM_IO_MEMORY || (stat("testbuffer.bin.wal", &st) == 0 && st.st_size < LOG_LIMIT),
+					"log stays bounded");
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// the pages written around the checkpoints made it to the file
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_LRU, NULL));
+	for (int i = 0; i < 50; i++)
+	{
+		TEST_CHECK(pinPage(bm, h, i));
+		sprintf(expected, "round 3 page %d", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "page holds the last change");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testLRU (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle *other = MAKE_PAGE_HANDLE();
+
+	testName = "test LRU replacement";
+
+	makePageFile("testbuffer.bin", 10);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	usePage(bm, h, 0);
+	usePage(bm, h, 1);
+	usePage(bm, h, 2);
+	usePage(bm, h, 0);
+
+	// the hit on page 0 leaves page 1 least recently used
+	usePage(bm, h, 3);
+	checkPool(bm, "[0x0],[3x0],[2x0]", "least recently used page replaced");
+	usePage(bm, h, 2);
+	usePage(bm, h, 4);
+	checkPool(bm, "[4x0],[3x0],[2x0]", "hit moves the page to the front");
+
+	// a pinned page at the end of the list is passed over
+	TEST_CHECK(pinPage(bm, other, 3));
+	usePage(bm, h, 5);
+	checkPool(bm, "[4x0],[3x1],[5x0]", "pin moves the page to the front");
+	usePage(bm, h, 6);
+	usePage(bm, h, 7);
+	checkPool(bm, "[6x0],[3x1],[7x0]", "pinned least recently used page kept");
+	TEST_CHECK(unpinPage(bm, other));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+	free(other);
+
+	TEST_DONE();
+}
+
+void
+testClock (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle *other = MAKE_PAGE_HANDLE();
+
+	testName = "test CLOCK replacement";
+
+	makePageFile("testbuffer.bin", 10);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CLOCK, NULL));
+	usePage(bm, h, 0);
+	usePage(bm, h, 1);
+	usePage(bm, h, 2);
+
+	// every frame was referenced: the hand clears them all and takes the first
+	usePage(bm, h, 3);
+	checkPool(bm, "[3x0],[1x0],[2x0]", "first frame replaced after a full sweep");
+
+	// page 1 gets a second chance, page 2 has none left
+	usePage(bm, h, 1);
+	usePage(bm, h, 4);
+	checkPool(bm, "[3x0],[1x0],[4x0]", "referenced page kept");
+
+	// a pinned frame is passed over, nothing is left once all are pinned
+	TEST_CHECK(pinPage(bm, other, 3));
+	usePage(bm, h, 5);
+	checkPool(bm, "[3x1],[5x0],[4x0]", "pinned page kept");
+	TEST_CHECK(pinPage(bm, h, 5));
+	TEST_CHECK(pinPage(bm, h, 4));
+	ASSERT_TRUE(pinPage(bm, h, 6) == RC_PINNED_PAGES_IN_BUFFER, "no frame left");
+	TEST_CHECK(unpinPage(bm, h));
+	h->pageNum = 5;
+	TEST_CHECK(unpinPage(bm, h));
+	TEST_CHECK(unpinPage(bm, other));
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+	free(other);
+
+	TEST_DONE();
+}
+
+void
+testLFU (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	testName = "test LFU replacement and aging";
+
+	makePageFile("testbuffer.bin", 200);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LFU, NULL));
+	for (int i = 0; i < 3; i++)
+		usePage(bm, h, 0);
+	usePage(bm, h, 1);
+	usePage(bm, h, 1);
+	usePage(bm, h, 2);
+
+	// the least used page goes, among equals the one counted there first
+	usePage(bm, h, 3);
+	checkPool(bm, "[0x0],[1x0],[3x0]", "least frequently used page replaced");
+	usePage(bm, h, 4);
+	checkPool(bm, "[0x0],[1x0],[4x0]", "new page replaced first");
+	usePage(bm, h, 4);
+	usePage(bm, h, 4);
+	usePage(bm, h, 5);
+	checkPool(bm, "[0x0],[5x0],[4x0]", "page used twice replaced before one used three times");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// a page that was hot once keeps its frame for a while ...
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LFU, NULL));
+	for (int i = 0; i < 20; i++)
+		usePage(bm, h, 0);
+	for (int p = 1; p <= 40; p++)
+		usePage(bm, h, p);
+	checkPool(bm, "[0x0],[39x0],[40x0]", "hot page survives a scan");
+
+	// ... but the counts are halved every 24 pins, until it is no different
+	for (int p = 41; p <= 102; p++)
+		usePage(bm, h, p);
+	checkPool(bm, "[101x0],[102x0],[100x0]", "aged page replaced");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testLRUK (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_LRUKParams params = { 2, 2 };
+
+	testName = "test LRU-K replacement";
+
+	makePageFile("testbuffer.bin", 30);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, NULL));
+	usePage(bm, h, 0);
+	usePage(bm, h, 0);
+	usePage(bm, h, 1);
+	usePage(bm, h, 2);
+
+	// pages referenced only once go first, the least recently used of them
+	usePage(bm, h, 3);
+	checkPool(bm, "[0x0],[3x0],[2x0]", "page referenced once replaced");
+	usePage(bm, h, 4);
+	checkPool(bm, "[0x0],[3x0],[4x0]", "page referenced twice kept");
+	for (int p = 5; p <= 20; p++)
+		usePage(bm, h, p);
+	checkPool(bm, "[0x0],[19x0],[20x0]", "page referenced twice survives a scan");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// with a correlated period of 2 the second pin of page 0 is part of its
+	// first reference, page 0 is no better than the scan; pages pinned within
+	// the period are not replaced while another page can be
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, &params));
+	usePage(bm, h, 0);
+	usePage(bm, h, 0);
+	usePage(bm, h, 1);
+	usePage(bm, h, 2);
+	usePage(bm, h, 3);
+	checkPool(bm, "[3x0],[1x0],[2x0]", "correlated pins count as one reference");
+	usePage(bm, h, 1);
+	usePage(bm, h, 5);
+	usePage(bm, h, 6);
+	checkPool(bm, "[6x0],[1x0],[5x0]", "pages within their correlated period kept");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testARC (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	testName = "test ARC replacement";
+
+	makePageFile("testbuffer.bin", 20);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_ARC, NULL));
+	usePage(bm, h, 0);
+	usePage(bm, h, 1);
+	usePage(bm, h, 0);
+	usePage(bm, h, 1);
+
+	// pages 0 and 1 are in T2, a scan only cycles through T1
+	for (int p = 2; p <= 8; p++)
+		usePage(bm, h, p);
+	checkPool(bm, "[0x0],[1x0],[8x0],[7x0]", "scan stays in T1");
+
+	// pages 5 and 6 are in B1: each miss on them makes T1's target larger,
+	// the first one still takes a T1 frame, the second one the oldest of T2
+	usePage(bm, h, 5);
+	checkPool(bm, "[0x0],[1x0],[8x0],[5x0]", "first ghost hit replaces a T1 page");
+	usePage(bm, h, 6);
+	checkPool(bm, "[6x0],[1x0],[8x0],[5x0]", "second ghost hit replaces a T2 page");
+
+	// T1 is below its target now, a new page takes a T2 frame as well
+	usePage(bm, h, 9);
+	checkPool(bm, "[6x0],[9x0],[8x0],[5x0]", "T1 grows towards its target");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+test2Q (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+
+	testName = "test 2Q replacement";
+
+	// A1in holds a quarter of the 4 frames, A1out remembers 2 pages
+	makePageFile("testbuffer.bin", 20);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_2Q, NULL));
+	for (int p = 0; p <= 4; p++)
+		usePage(bm, h, p);
+	checkPool(bm, "[4x0],[1x0],[2x0],[3x0]", "oldest page of A1in replaced");
+
+	// page 0 is in A1out, back in the pool it goes to Am and stays there
+	usePage(bm, h, 0);
+	checkPool(bm, "[4x0],[0x0],[2x0],[3x0]", "page back from A1out loaded");
+	for (int p = 5; p <= 9; p++)
+		usePage(bm, h, p);
+	checkPool(bm, "[7x0],[0x0],[8x0],[9x0]", "page in Am survives a scan");
+
+	// a hit in A1in does not promote the page
+	usePage(bm, h, 8);
+	usePage(bm, h, 10);
+	usePage(bm, h, 11);
+	checkPool(bm, "[10x0],[0x0],[11x0],[9x0]", "page used twice in A1in replaced");
+
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testTwoPools (void)
+{
+	BM_BufferPool *lru = MAKE_POOL();
+	BM_BufferPool *fifo = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[PAGE_SIZE];
+
+	testName = "test two pools open at once";
+
+	makePageFile("testbuffer.bin", 10);
+	makePageFile("testbuffer2.bin", 10);
+	TEST_CHECK(initBufferPool(lru, "testbuffer.bin", 3, RS_LRU, NULL));
+	TEST_CHECK(initBufferPool(fifo, "testbuffer2.bin", 2, RS_FIFO, NULL));
+
+	// the same pages in both pools, with different contents
+	for (int i = 0; i < 6; i++)
+	{
+		TEST_CHECK(pinPage(lru, h, i));
+		sprintf(h->data, "lru page %d", i);
+		TEST_CHECK(markDirty(lru, h));
+		TEST_CHECK(unpinPage(lru, h));
+		TEST_CHECK(pinPage(fifo, h, i));
+		sprintf(h->data, "fifo page %d", i);
+		TEST_CHECK(markDirty(fifo, h));
+		TEST_CHECK(unpinPage(fifo, h));
+	}
+	checkPool(lru, "[3x0],[4x0],[5x0]", "LRU pool holds its last 3 pages");
+	checkPool(fifo, "[4x0],[5x0]", "FIFO pool holds its last 2 pages");
+	ASSERT_TRUE(getNumReadIO(lru) == 6 && getNumWriteIO(lru) == 3, "LRU pool counts its own I/O");
+	ASSERT_TRUE(getNumReadIO(fifo) == 6 && getNumWriteIO(fifo) == 4, "FIFO pool counts its own I/O");
+
+	// closing one pool leaves the other alone
+	TEST_CHECK(shutdownBufferPool(lru));
+	TEST_CHECK(pinPage(fifo, h, 5));
+	ASSERT_EQUALS_STRING("fifo page 5", h->data, "page of the other pool still cached");
+	TEST_CHECK(unpinPage(fifo, h));
+	TEST_CHECK(shutdownBufferPool(fifo));
+
+	TEST_CHECK(initBufferPool(lru, "testbuffer.bin", 3, RS_LRU, NULL));
+	TEST_CHECK(initBufferPool(fifo, "testbuffer2.bin", 2, RS_FIFO, NULL));
+	for (int i = 0; i < 6; i++)
+	{
+		TEST_CHECK(pinPage(lru, h, i));
+		sprintf(expected, "lru page %d", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "page of the LRU pool written to its file");
+		TEST_CHECK(unpinPage(lru, h));
+		TEST_CHECK(pinPage(fifo, h, i));
+		sprintf(expected, "fifo page %d", i);
+		ASSERT_EQUALS_STRING(expected, h->data, "page of the FIFO pool written to its file");
+		TEST_CHECK(unpinPage(fifo, h));
+	}
+
+	TEST_CHECK(shutdownBufferPool(lru));
+	TEST_CHECK(shutdownBufferPool(fifo));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	TEST_CHECK(destroyPageFile("testbuffer2.bin"));
+	free(lru);
+	free(fifo);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testConcurrentPins (void)
+{
+	ReplacementStrategy strategies[] = { RS_FIFO, RS_LRU, RS_CLOCK, RS_LFU, RS_LRU_K, RS_ARC, RS_2Q };
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	StressWorker workers[STRESS_THREADS];
+	pthread_t threads[STRESS_THREADS];
+	int updates[STRESS_PAGES];
+	char expected[PAGE_SIZE];
+
+	testName = "test pins from many threads";
+
+	for (size_t s = 0; s < sizeof(strategies) / sizeof(strategies[0]); s++)
+	{
+		makePageFile("testbuffer.bin", STRESS_PAGES);
+		TEST_CHECK(initBufferPool(bm, "testbuffer.bin", STRESS_THREADS + 4, strategies[s], NULL));
+		for (int p = 0; p < STRESS_PAGES; p++)
+			usePage(bm, h, p);
+		memset(updates, 0, sizeof(updates));
+
+		for (int t = 0; t < STRESS_THREADS; t++)
+		{
+			workers[t].bm = bm;
+			workers[t].id = t;
+			workers[t].updates = updates;
+			workers[t].failures = 0;
+			ASSERT_TRUE(pthread_create(&threads[t], NULL, stressPool, &workers[t]) == 0, "thread started");
+		}
+		for (int t = 0; t < STRESS_THREADS; t++)
+		{
+			pthread_join(threads[t], NULL);
+			ASSERT_TRUE(workers[t].failures == 0, "every pin of the thread succeeded and saw its page");
+		}
+
+		int *fixCounts = getFixCounts(bm);
+		int pinned = 0;
+		for (int i = 0; i < bm->numPages; i++)
+			pinned += fixCounts[i];
+		free(fixCounts);
+		ASSERT_TRUE(pinned == 0, "every pin undone");
+		TEST_CHECK(shutdownBufferPool(bm));
+
+		// every update of every page made it to the file
+		TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+		for (int p = 0; p < STRESS_PAGES; p++)
+		{
+			TEST_CHECK(pinPage(bm, h, p));
+			sprintf(expected, "page %d", p);
+			ASSERT_EQUALS_STRING(expected, h->data, "page header kept");
+			ASSERT_TRUE(memcmp(h->data + 64, &updates[p], sizeof(int)) == 0, "every update of the page written");
+			TEST_CHECK(unpinPage(bm, h));
+		}
+		TEST_CHECK(shutdownBufferPool(bm));
+		TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	}
+
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testConcurrentHits (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle held[HIT_FRAMES];
+	HitWorker workers[HIT_THREADS];
+	pthread_t threads[HIT_THREADS];
+	pthread_barrier_t start;
+	int lost = 0;
+
+	testName = "test hits from many threads at once";
+
+	makePageFile("testbuffer.bin", 2 * HIT_FRAMES);
+	pthread_barrier_init(&start, NULL, HIT_THREADS);
+	for (int r = 0; r < HIT_ROUNDS; r++)
+	{
+		TEST_CHECK(initBufferPool(bm, "testbuffer.bin", HIT_FRAMES, RS_LFU, NULL));
+		for (int p = 0; p < HIT_FRAMES; p++)
+		{
+			TEST_CHECK(pinPage(bm, h, p));
+			TEST_CHECK(unpinPage(bm, h));
+		}
+
+		// the threads pin their pages HIT_PINS more times, all at once, the
+		// page after theirs is pinned one time less by this thread alone
+		for (int t = 0; t < HIT_THREADS; t++)
+		{
+			workers[t].bm = bm;
+			workers[t].id = t;
+			workers[t].start = &start;
+			workers[t].failures = 0;
+			ASSERT_TRUE(pthread_create(&threads[t], NULL, hitPage, &workers[t]) == 0, "thread started");
+		}
+		for (int t = 0; t < HIT_THREADS; t++)
+		{
+			pthread_join(threads[t], NULL);
+			ASSERT_TRUE(workers[t].failures == 0, "hits pinned and unpinned the page");
+		}
+		for (int i = 1; i < HIT_PINS; i++)
+		{
+			TEST_CHECK(pinPage(bm, h, HIT_THREADS));
+			TEST_CHECK(unpinPage(bm, h));
+		}
+
+		// new pages replace the pages used once and then that one, unless a
+		// hit went uncounted and left the page of a thread behind it
+		for (int p = HIT_THREADS; p < HIT_FRAMES; p++)
+			TEST_CHECK(pinPage(bm, &held[p], HIT_FRAMES + p));
+		PageNumber *pages = getFrameContents(bm);
+		for (int t = 0; t < HIT_THREADS; t++)
+			lost += pages[t] != t;
+		free(pages);
+		for (int p = HIT_THREADS; p < HIT_FRAMES; p++)
+			TEST_CHECK(unpinPage(bm, &held[p]));
+		TEST_CHECK(shutdownBufferPool(bm));
+	}
+	ASSERT_TRUE(lost == 0, "every hit counted");
+
+	pthread_barrier_destroy(&start);
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testFlusher (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	char expected[PAGE_SIZE];
+
+	testName = "test background flusher";
+
+	makePageFile("testbuffer.bin", FLUSH_FRAMES);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", FLUSH_FRAMES, RS_LRU, NULL));
+	ASSERT_TRUE(startPoolFlusher(bm, 1) == RC_FAILED, "ratio of 1 refused");
+	TEST_CHECK(startPoolFlusher(bm, 0.5));
+	for (int p = 0; p < FLUSH_FRAMES; p++)
+		usePage(bm, h, p);
+
+	// the flusher writes the pages past half the frames, and no more
+	ASSERT_TRUE(waitForDirty(bm, FLUSH_FRAMES / 2) == FLUSH_FRAMES / 2, "flusher wrote down to its target");
+
+	// started again it takes the new target; once it is stopped its writes
+	// are done
+	TEST_CHECK(startPoolFlusher(bm, 0));
+	ASSERT_TRUE(waitForDirty(bm, 0) == 0, "flusher wrote down to its new target");
+	TEST_CHECK(stopPoolFlusher(bm));
+	ASSERT_TRUE(getNumWriteIO(bm) == FLUSH_FRAMES, "flusher wrote every page once");
+
+	// nothing was left to write at shutdown
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+	for (int p = 0; p < FLUSH_FRAMES; p++)
+	{
+		TEST_CHECK(pinPage(bm, h, p));
+		sprintf(expected, "page %d", p);
+		ASSERT_EQUALS_STRING(expected, h->data, "page written by the flusher");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testPrefetch (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	BM_PageHandle held[3];
+	PageNumber pageNums[PREFETCH_PAGES];
+	char expected[PAGE_SIZE];
+
+	testName = "test prefetching pages";
+
+	makePageFile("testbuffer.bin", PREFETCH_PAGES);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+	for (int p = 0; p < PREFETCH_PAGES; p++)
+		usePage(bm, h, p);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// each page is read once, by prefetchPages; the pins find them read in
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", PREFETCH_PAGES + 2, RS_LRU, NULL));
+	for (int k = 0; k < PREFETCH_PAGES; k++)
+		pageNums[k] = PREFETCH_PAGES - 1 - k;
+	TEST_CHECK(prefetchPages(bm, pageNums, PREFETCH_PAGES));
+	ASSERT_TRUE(getNumReadIO(bm) == PREFETCH_PAGES, "prefetch read every page");
+	TEST_CHECK(prefetchPages(bm, pageNums, PREFETCH_PAGES));
+	ASSERT_TRUE(getNumReadIO(bm) == PREFETCH_PAGES, "pages in the pool not read again");
+	for (int p = 0; p < PREFETCH_PAGES; p++)
+	{
+		TEST_CHECK(pinPage(bm, h, p));
+		sprintf(expected, "page %d", p);
+		ASSERT_EQUALS_STRING(expected, h->data, "prefetched page read in");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	ASSERT_TRUE(getNumReadIO(bm) == PREFETCH_PAGES, "pins of prefetched pages read nothing");
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	// with every frame pinned the pages are left to pinPage
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	for (int k = 0; k < 3; k++)
+		TEST_CHECK(pinPage(bm, &held[k], k));
+	TEST_CHECK(prefetchPages(bm, pageNums, PREFETCH_PAGES));
+	ASSERT_TRUE(getNumReadIO(bm) == 3, "no page prefetched without a free frame");
+	for (int k = 0; k < 3; k++)
+		TEST_CHECK(unpinPage(bm, &held[k]));
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+void
+testPastEndOfFile (void)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_FileHandle fh;
+	char expected[PAGE_SIZE];
+
+	testName = "test pages past the end of the file";
+
+	// page 5 of a 1 page file is changed and has to be written back to make
+	// room; the file grows over the gap
+	makePageFile("testbuffer.bin", 1);
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+	TEST_CHECK(pinPage(bm, h, 5));
+	sprintf(h->data, "page 5 first");
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+	for (int p = 10; p < 13; p++)
+		usePage(bm, h, p);
+	TEST_CHECK(pinPage(bm, h, 5));
+	ASSERT_EQUALS_STRING("page 5 first", h->data, "page past a gap written back");
+	TEST_CHECK(unpinPage(bm, h));
+
+	for (int p = 0; p < 20; p++)
+		usePage(bm, h, p);
+	TEST_CHECK(shutdownBufferPool(bm));
+
+	TEST_CHECK(openPageFile("testbuffer.bin", &fh));
+	ASSERT_TRUE(fh.totalNumPages == 20, "file grew to the last page written");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+	for (int p = 0; p < 20; p++)
+	{
+		TEST_CHECK(pinPage(bm, h, p));
+		sprintf(expected, "page %d", p);
+		ASSERT_EQUALS_STRING(expected, h->data, "page written back");
+		TEST_CHECK(unpinPage(bm, h));
+	}
+	TEST_CHECK(shutdownBufferPool(bm));
+	TEST_CHECK(destroyPageFile("testbuffer.bin"));
+	free(bm);
+	free(h);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+// a new page file of numPages empty pages
+void
+makePageFile (char *fileName, int numPages)
+{
+	SM_FileHandle fh;
+
+	TEST_CHECK(createPageFile(fileName));
+	TEST_CHECK(openPageFile(fileName, &fh));
+	TEST_CHECK(ensureCapacity(numPages, &fh));
+	TEST_CHECK(closePageFile(&fh));
+}
+
+// pin a page, change it and let go of it
+void
+usePage (BM_BufferPool *bm, BM_PageHandle *h, PageNumber pageNum)
+{
+	TEST_CHECK(pinPage(bm, h, pageNum));
+	sprintf(h->data, "page %lld", (long long) pageNum);
+	TEST_CHECK(markDirty(bm, h));
+	TEST_CHECK(unpinPage(bm, h));
+}
+
+// compare the pages in the frames and their fix counts, see sprintPoolContent
+void
+checkPool (BM_BufferPool *bm, char *expected, char *message)
+{
+	char *content = sprintPoolContent(bm);
+
+	ASSERT_EQUALS_STRING(expected, content, message);
+	free(content);
+}
+
+// pin random pages of the pool, updating those the worker writes
+void *
+stressPool (void *arg)
+{
+	StressWorker *w = (StressWorker *) arg;
+	unsigned int seed = w->id * 7919 + 1;
+	BM_PageHandle h;
+	char expected[32];
+	RC rc;
+
+	for (int i = 0; i < STRESS_PINS; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		int p = (seed >> 8) % STRESS_PAGES;
+
+		// a miss may find every frame pinned by the other threads for a moment
+		while ((rc = pinPage(w->bm, &h, p)) == RC_PINNED_PAGES_IN_BUFFER)
+			;
+		if (rc != RC_OK)
+		{
+			w->failures++;
+			continue;
+		}
+		sprintf(expected, "page %d", p);
+		if (strcmp(h.data, expected) != 0)
+			w->failures++;
+		if (p % STRESS_THREADS == w->id)
+		{
+			int count;
+			memcpy(&count, h.data + 64, sizeof(int));
+			count++;
+			memcpy(h.data + 64, &count, sizeof(int));
+			w->updates[p]++;
+			if (markDirty(w->bm, &h) != RC_OK)
+				w->failures++;
+			if (i % 97 == 0 && forcePage(w->bm, &h) != RC_OK)
+				w->failures++;
+		}
+		if (unpinPage(w->bm, &h) != RC_OK)
+			w->failures++;
+	}
+	return NULL;
+}
+
+// pin the page of the worker HIT_PINS times once all workers are ready
+void *
+hitPage (void *arg)
+{
+	HitWorker *w = (HitWorker *) arg;
+	BM_PageHandle h;
+
+	pthread_barrier_wait(w->start);
+	for (int i = 0; i < HIT_PINS; i++)
+		if (pinPage(w->bm, &h, w->id) != RC_OK || unpinPage(w->bm, &h) != RC_OK)
+			w->failures++;
+	return NULL;
+}
+
+// wait until at most maxDirty frames of the pool are dirty, or for
+// FLUSH_WAIT_MS; returns the dirty frames
+int
+waitForDirty (BM_BufferPool *bm, int maxDirty)
+{
+	int numDirty = bm->numPages;
+
+	for (int waited = 0; waited < FLUSH_WAIT_MS; waited++)
+	{
+		bool *dirty = getDirtyFlags(bm);
+		numDirty = 0;
+		for (int i = 0; i < bm->numPages; i++)
+			numDirty += dirty[i];
+		free(dirty);
+		if (numDirty <= maxDirty)
+			break;
+		usleep(1000);
+	}
+	return numDirty;
+}
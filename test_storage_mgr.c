@@ -0,0 +1,859 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "storage_mgr.h"
+#include "wal_mgr.h"
+#include "dberror.h"
+#include "test_helper.h"
+
+// a page number whose byte offset no longer fits into 32 bits
+#define FAR_PAGE ((PageNumber)3 * 1024 * 1024 * 1024 / PAGE_SIZE)
+
+// pages written by the backend round trips
+#define RT_PAGES 16
+// pages covered by one free-space bitmap of a file with 4 KB pages
+#define FSM_GROUP 32640
+// transfers in flight at once, more than an io_uring ring holds
+#define ASYNC_PAGES 300
+
+// test methods
+static void testLargePageFile (void);
+static void testBlockPosition (void);
+static void testPageSizes (void);
+static void testSequentialScan (void);
+static void testLogRecovery (void);
+static void testMmapBackend (void);
+static void testAsyncIO (void);
+static void testVectoredIO (void);
+static void testGrowthPolicy (void);
+static void testDirectIO (void);
+static void testChecksums (void);
+static void testCompressedBackend (void);
+static void testPageRecycling (void);
+static void testMemoryBackend (void);
+
+// helpers
+static void fillPage (SM_PageHandle ph, int value);
+static int pageHolds (SM_PageHandle ph, int value);
+static void checkRoundTrip (SM_IOMode mode, char *fileName);
+
+char *testName;
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	initStorageManager();
+
+	testLargePageFile();
+	testBlockPosition();
+	testPageSizes();
+	testSequentialScan();
+	testLogRecovery();
+	testMmapBackend();
+	testAsyncIO();
+	testVectoredIO();
+	testGrowthPolicy();
+	testDirectIO();
+	testChecksums();
+	testCompressedBackend();
+	testPageRecycling();
+	testMemoryBackend();
+
+	return 0;
+}
+
+// ************************************************************
+void
+testLargePageFile (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+
+	testName = "test page file larger than 2 GB";
+
+	TEST_CHECK(createPageFile("testlarge.bin"));
+	TEST_CHECK(openPageFile("testlarge.bin", &fh));
+
+	// grows the file past 3 GB, the unused pages stay sparse
+	TEST_CHECK(ensureCapacity(FAR_PAGE + 1, &fh));
+	ASSERT_TRUE(fh.totalNumPages == FAR_PAGE + 1, "file grew past 2 GB");
+
+	memset(ph, 0, PAGE_SIZE);
+	sprintf(ph, "page %lld", FAR_PAGE);
+	TEST_CHECK(writeBlock(FAR_PAGE, &fh, ph));
+	TEST_CHECK(closePageFile(&fh));
+
+	// reopen and read the far page back
+	TEST_CHECK(openPageFile("testlarge.bin", &fh));
+	ASSERT_TRUE(fh.totalNumPages == FAR_PAGE + 1, "page count survives reopening");
+	memset(ph, 0, PAGE_SIZE);
+	TEST_CHECK(readLastBlock(&fh, ph));
+	ASSERT_TRUE(strncmp(ph, "page ", 5) == 0 && atoll(ph + 5) == FAR_PAGE, "last page holds what was written");
+
+	// a page between the written ones reads back as zeros
+	TEST_CHECK(readBlock(FAR_PAGE / 2, &fh, ph));
+	ASSERT_TRUE(ph[0] == 0 && ph[PAGE_DATA_SIZE - 1] == 0, "sparse page is empty");
+
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testlarge.bin"));
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+void
+testBlockPosition (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+
+	testName = "test current block position";
+
+	TEST_CHECK(createPageFile("testpos.bin"));
+	TEST_CHECK(openPageFile("testpos.bin", &fh));
+	TEST_CHECK(ensureCapacity(3, &fh));
+
+	// the position is the page last read or written
+	memset(ph, 0, PAGE_SIZE);
+	ph[0] = '2';
+	TEST_CHECK(writeBlock(2, &fh, ph));
+	ASSERT_TRUE(getBlockPos(&fh) == 2, "position after write");
+
+	TEST_CHECK(readPreviousBlock(&fh, ph));
+	ASSERT_TRUE(getBlockPos(&fh) == 1, "position after reading the previous page");
+	TEST_CHECK(readNextBlock(&fh, ph));
+	ASSERT_TRUE(ph[0] == '2', "next page is the one written");
+	TEST_CHECK(readCurrentBlock(&fh, ph));
+	ASSERT_TRUE(ph[0] == '2', "current page is the one read last");
+	ASSERT_ERROR(readNextBlock(&fh, ph), "no page past the last one");
+
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testpos.bin"));
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+void
+testPageSizes (void)
+{
+	int sizes[] = {8192, 16384, 32768, 65536};
+	SM_FileHandle fh;
+
+	testName = "test page sizes";
+
+	ASSERT_ERROR(setPageSize(PAGE_SIZE + 1), "page size must be supported");
+
+	for (int i = 0; i < 4; i++)
+	{
+		int pageSize = sizes[i];
+		SM_PageHandle ph = allocPageBufferOf(pageSize);
+
+		TEST_CHECK(setPageSize(pageSize));
+		TEST_CHECK(createPageFile("testsize.bin"));
+
+		// the file keeps its page size whatever the current one is
+		TEST_CHECK(setPageSize(PAGE_SIZE));
+		TEST_CHECK(openPageFile("testsize.bin", &fh));
+		ASSERT_EQUALS_INT(pageSize, fh.pageSize, "page size recorded in the file");
+
+		memset(ph, 'p', pageSize);
+		TEST_CHECK(writeBlock(1, &fh, ph));
+		TEST_CHECK(closePageFile(&fh));
+
+		TEST_CHECK(openPageFile("testsize.bin", &fh));
+		ASSERT_TRUE(fh.totalNumPages == 2, "file holds two pages");
+		memset(ph, 0, pageSize);
+		TEST_CHECK(readBlock(1, &fh, ph));
+		ASSERT_TRUE(ph[0] == 'p' && ph[PAGE_DATA_SIZE_OF(pageSize) - 1] == 'p', "whole page read back");
+
+		TEST_CHECK(closePageFile(&fh));
+		TEST_CHECK(destroyPageFile("testsize.bin"));
+		freePageBuffer(ph);
+	}
+
+	TEST_DONE();
+}
+
+void
+testSequentialScan (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+	int numPages = 300;
+
+	testName = "test sequential scan with readahead";
+
+	TEST_CHECK(createPageFile("testscan.bin"));
+	TEST_CHECK(openPageFile("testscan.bin", &fh));
+	for (int i = 0; i < numPages; i++)
+	{
+		memset(ph, 0, PAGE_SIZE);
+		sprintf(ph, "page %d", i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	// a forward scan reads every page in order, readahead only hints the OS
+	TEST_CHECK(openPageFile("testscan.bin", &fh));
+	TEST_CHECK(readFirstBlock(&fh, ph));
+	for (int i = 1; i < numPages; i++)
+	{
+		TEST_CHECK(readNextBlock(&fh, ph));
+		ASSERT_TRUE(strncmp(ph, "page ", 5) == 0 && atoi(ph + 5) == i, "scan reads the pages in order");
+	}
+	ASSERT_ERROR(readNextBlock(&fh, ph), "scan ends at the last page");
+	TEST_CHECK(closePageFile(&fh));
+
+	// jumping back after a scan still reads the right page
+	TEST_CHECK(openPageFile("testscan.bin", &fh));
+	TEST_CHECK(readBlock(numPages - 1, &fh, ph));
+	TEST_CHECK(readBlock(7, &fh, ph));
+	ASSERT_TRUE(atoi(ph + 5) == 7, "random read after scan");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(destroyPageFile("testscan.bin"));
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+void
+testLogRecovery (void)
+{
+	SM_FileHandle fh;
+	WAL_LogHandle log;
+	SM_PageHandle ph = allocPageBuffer();
+	LSN lsn;
+	FILE *tail;
+
+	testName = "test write-ahead log recovery";
+
+	TEST_CHECK(createPageFile("testwal.bin"));
+	TEST_CHECK(openPageFile("testwal.bin", &fh));
+	TEST_CHECK(openLog("testwal.log", &log));
+	TEST_CHECK(truncateLog(&log));
+
+	// page 5 lies past the end of the file, page 2 is logged twice
+	memset(ph, 'a', PAGE_SIZE);
+	TEST_CHECK(appendLogRecord(&log, &fh, 2, ph, &lsn));
+	memset(ph, 'b', PAGE_SIZE);
+	TEST_CHECK(appendLogRecord(&log, &fh, 5, ph, &lsn));
+	memset(ph, 'c', PAGE_SIZE);
+	TEST_CHECK(appendLogRecord(&log, &fh, 2, ph, &lsn));
+	TEST_CHECK(commitLog(&log, lsn));
+	TEST_CHECK(closeLog(&log));
+
+	// a crash while appending leaves a partial record behind
+	tail = fopen("testwal.log", "ab");
+	fwrite(ph, 1, 100, tail);
+	fclose(tail);
+
+	// none of the pages made it into the page file before the crash
+	TEST_CHECK(openLog("testwal.log", &log));
+	TEST_CHECK(replayLog(&log, &fh));
+	ASSERT_TRUE(fh.totalNumPages == 6, "replay grows the file");
+	TEST_CHECK(readBlock(2, &fh, ph));
+	ASSERT_TRUE(ph[0] == 'c', "last image of a page wins");
+	TEST_CHECK(readBlock(5, &fh, ph));
+	ASSERT_TRUE(ph[0] == 'b' && ph[PAGE_DATA_SIZE - 1] == 'b', "page past the end replayed");
+	TEST_CHECK(closeLog(&log));
+	TEST_CHECK(closePageFile(&fh));
+
+	// a new file of the same name ignores the log of the old one
+	TEST_CHECK(createPageFile("testwal.bin"));
+	TEST_CHECK(openPageFile("testwal.bin", &fh));
+	TEST_CHECK(openLog("testwal.log", &log));
+	TEST_CHECK(replayLog(&log, &fh));
+	ASSERT_TRUE(fh.totalNumPages == 1, "log of another file not replayed");
+
+	TEST_CHECK(closeLog(&log));
+	TEST_CHECK(destroyLog("testwal.log"));
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testwal.bin"));
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+void
+testMmapBackend (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+	SM_PageHandle ptr;
+
+	testName = "test memory-mapped backend";
+
+	checkRoundTrip(SM_IO_FILE, "testfile.bin");
+	checkRoundTrip(SM_IO_MMAP, "testmmap.bin");
+
+	// the mapping is remapped when the file grows and hands out the stored page
+	setIOMode(SM_IO_MMAP);
+	TEST_CHECK(createPageFile("testmmap.bin"));
+	TEST_CHECK(openPageFile("testmmap.bin", &fh));
+	TEST_CHECK(ensureCapacity(4, &fh));
+	fillPage(ph, 3);
+	TEST_CHECK(writeBlock(3, &fh, ph));
+	TEST_CHECK(ensureCapacity(1000, &fh));
+	TEST_CHECK(getBlockPtr(3, &fh, &ptr));
+	ASSERT_TRUE(pageHolds(ptr, 3), "pointer into the mapping");
+	ASSERT_ERROR(getBlockPtr(1000, &fh, &ptr), "no pointer past the last page");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testmmap.bin"));
+	setIOMode(SM_IO_FILE);
+
+	// a plain descriptor has no mapping to point into
+	TEST_CHECK(createPageFile("testfile.bin"));
+	TEST_CHECK(openPageFile("testfile.bin", &fh));
+	ASSERT_ERROR(getBlockPtr(0, &fh, &ptr), "no pointer without a mapping");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testfile.bin"));
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+void
+testAsyncIO (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle pages[ASYNC_PAGES];
+	SM_Completion done[ASYNC_PAGES];
+	char seen[ASYNC_PAGES] = {0};
+	int got, n;
+
+	testName = "test asynchronous block I/O";
+
+	for (int i = 0; i < ASYNC_PAGES; i++)
+		pages[i] = allocPageBuffer();
+	TEST_CHECK(createPageFile("testasync.bin"));
+	TEST_CHECK(openPageFile("testasync.bin", &fh));
+	TEST_CHECK(ensureCapacity(ASYNC_PAGES, &fh));
+
+	// more transfers in flight than the ring holds, each returns its tag once
+	for (int i = 0; i < ASYNC_PAGES; i++)
+	{
+		fillPage(pages[i], i);
+		TEST_CHECK(writeBlockAsync(i, &fh, pages[i], (char *) seen + i));
+	}
+	for (got = 0; got < ASYNC_PAGES; got += n)
+	{
+		n = pollBlockCompletions(&fh, done, 1, ASYNC_PAGES);
+		ASSERT_TRUE(n > 0, "writes complete");
+		for (int j = 0; j < n; j++)
+		{
+			int page = (int) ((SM_PageHandle) done[j].tag - (SM_PageHandle) seen);
+
+			TEST_CHECK(done[j].rc);
+			ASSERT_TRUE(page >= 0 && page < ASYNC_PAGES && !seen[page], "tag of the write returned once");
+			seen[page] = 1;
+		}
+	}
+	ASSERT_TRUE(pollBlockCompletions(&fh, done, 0, ASYNC_PAGES) == 0, "nothing left to complete");
+
+	// one vectored read of the whole file completes as a single transfer
+	for (int i = 0; i < ASYNC_PAGES; i++)
+		memset(pages[i], 0, PAGE_SIZE);
+	TEST_CHECK(readBlocksAsync(0, ASYNC_PAGES, &fh, pages, &fh));
+	ASSERT_TRUE(pollBlockCompletions(&fh, done, 1, ASYNC_PAGES) == 1, "one completion per run");
+	ASSERT_TRUE(done[0].tag == &fh && done[0].rc == RC_OK, "run read");
+	for (int i = 0; i < ASYNC_PAGES; i++)
+		ASSERT_TRUE(pageHolds(pages[i], i), "run read back");
+
+	// a vectored write past the end grows the file
+	TEST_CHECK(writeBlocksAsync(ASYNC_PAGES, ASYNC_PAGES, &fh, pages, NULL));
+	ASSERT_TRUE(pollBlockCompletions(&fh, done, 1, ASYNC_PAGES) == 1 && done[0].rc == RC_OK, "appending run written");
+	ASSERT_TRUE(fh.totalNumPages == 2 * ASYNC_PAGES, "file grew by the run");
+
+	// closing waits for transfers still in flight
+	for (int i = 0; i < ASYNC_PAGES; i++)
+		TEST_CHECK(readBlockAsync(ASYNC_PAGES + i, &fh, pages[i], NULL));
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(openPageFile("testasync.bin", &fh));
+	TEST_CHECK(readBlock(2 * ASYNC_PAGES - 1, &fh, pages[0]));
+	ASSERT_TRUE(pageHolds(pages[0], ASYNC_PAGES - 1), "appended run survives reopening");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testasync.bin"));
+	for (int i = 0; i < ASYNC_PAGES; i++)
+		freePageBuffer(pages[i]);
+
+	TEST_DONE();
+}
+
+void
+testVectoredIO (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle pages[RT_PAGES * 3];
+	PageNumber list[] = {12, 10, 5, 11, 50, 30, 49};
+	int numList = sizeof(list) / sizeof(list[0]);
+
+	testName = "test vectored and list I/O";
+
+	for (int i = 0; i < RT_PAGES * 3; i++)
+		pages[i] = allocPageBuffer();
+	TEST_CHECK(createPageFile("testvec.bin"));
+	TEST_CHECK(openPageFile("testvec.bin", &fh));
+
+	// a run may start one past the last page and grows the file
+	for (int i = 0; i < RT_PAGES * 3; i++)
+		fillPage(pages[i], i);
+	TEST_CHECK(writeBlocks(1, RT_PAGES * 3, &fh, pages));
+	ASSERT_TRUE(fh.totalNumPages == RT_PAGES * 3 + 1, "run grows the file");
+	ASSERT_TRUE(getBlockPos(&fh) == RT_PAGES * 3, "position is the last page of the run");
+	ASSERT_ERROR(writeBlocks(RT_PAGES * 3 + 2, 1, &fh, pages), "run must not leave a gap");
+	ASSERT_ERROR(readBlocks(RT_PAGES * 3, 2, &fh, pages), "run must lie inside the file");
+
+	for (int i = 0; i < RT_PAGES * 3; i++)
+		memset(pages[i], 0, PAGE_SIZE);
+	TEST_CHECK(readBlocks(1, RT_PAGES * 3, &fh, pages));
+	for (int i = 0; i < RT_PAGES * 3; i++)
+		ASSERT_TRUE(pageHolds(pages[i], i), "run read back");
+
+	// the list is sorted into runs, the last one appends pages 49 and 50
+	for (int i = 0; i < numList; i++)
+		fillPage(pages[i], 1000 + list[i]);
+	TEST_CHECK(writeBlockList(list, numList, &fh, pages));
+	ASSERT_TRUE(fh.totalNumPages == 51, "list grows the file");
+
+	for (int i = 0; i < numList; i++)
+		memset(pages[i], 0, PAGE_SIZE);
+	TEST_CHECK(readBlockList(list, numList, &fh, pages));
+	for (int i = 0; i < numList; i++)
+		ASSERT_TRUE(pageHolds(pages[i], 1000 + list[i]), "list read back into its own buffers");
+
+	// pages between the runs were left alone
+	TEST_CHECK(readBlocks(6, 4, &fh, pages));
+	for (int i = 0; i < 4; i++)
+		ASSERT_TRUE(pageHolds(pages[i], 5 + i), "pages between the runs untouched");
+
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testvec.bin"));
+	for (int i = 0; i < RT_PAGES * 3; i++)
+		freePageBuffer(pages[i]);
+
+	TEST_DONE();
+}
+
+void
+testGrowthPolicy (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+	struct stat st;
+
+	testName = "test file growth policy";
+
+	// the file grows by a hole, disk space is reserved for one chunk past its end
+	setGrowthPolicy(64);
+	TEST_CHECK(createPageFile("testgrow.bin"));
+	TEST_CHECK(openPageFile("testgrow.bin", &fh));
+	TEST_CHECK(ensureCapacity(100, &fh));
+	ASSERT_TRUE(fh.totalNumPages == 100, "file grew");
+	stat("testgrow.bin", &st);
+	ASSERT_TRUE(st.st_size < 102 * PAGE_SIZE, "file size covers the pages only");
+	ASSERT_TRUE(st.st_blocks * 512 >= 64 * PAGE_SIZE, "disk space reserved ahead");
+
+	// appending within the reservation keeps the pages empty
+	for (int i = 0; i < 10; i++)
+		TEST_CHECK(appendEmptyBlock(&fh));
+	ASSERT_TRUE(fh.totalNumPages == 110, "pages appended");
+	TEST_CHECK(readBlock(105, &fh, ph));
+	ASSERT_TRUE(ph[0] == 0 && ph[PAGE_DATA_SIZE - 1] == 0, "appended page is empty");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testgrow.bin"));
+
+	// without reservation growing leaves the file sparse
+	setGrowthPolicy(0);
+	TEST_CHECK(createPageFile("testgrow.bin"));
+	TEST_CHECK(openPageFile("testgrow.bin", &fh));
+	TEST_CHECK(ensureCapacity(1000, &fh));
+	stat("testgrow.bin", &st);
+	ASSERT_TRUE(st.st_blocks * 512 < 8 * PAGE_SIZE, "no disk space reserved");
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testgrow.bin"));
+
+	setGrowthPolicy(SM_DEFAULT_GROWTH_CHUNK);
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+void
+testDirectIO (void)
+{
+	SM_FileHandle fh;
+	char *raw = malloc(2 * PAGE_SIZE);
+	SM_PageHandle unaligned = raw + 1;
+	SM_PageHandle pages[2];
+
+	testName = "test O_DIRECT backend";
+
+	checkRoundTrip(SM_IO_DIRECT, "testdirect.bin");
+
+	// buffers that are not page aligned are refused before any I/O
+	setIOMode(SM_IO_DIRECT);
+	TEST_CHECK(createPageFile("testdirect.bin"));
+	TEST_CHECK(openPageFile("testdirect.bin", &fh));
+	memset(raw, 0, 2 * PAGE_SIZE);
+	ASSERT_TRUE(writeBlock(0, &fh, unaligned) == RC_UNALIGNED_BUFFER, "unaligned write refused");
+	ASSERT_TRUE(readBlock(0, &fh, unaligned) == RC_UNALIGNED_BUFFER, "unaligned read refused");
+	pages[0] = allocPageBuffer();
+	pages[1] = unaligned;
+	ASSERT_TRUE(readBlocks(0, 1, &fh, pages + 1) == RC_UNALIGNED_BUFFER, "unaligned run refused");
+	ASSERT_TRUE(fh.totalNumPages == 1, "refused write did not grow the file");
+
+	// an aligned buffer from allocPageBuffer works
+	fillPage(pages[0], 7);
+	TEST_CHECK(writeBlock(0, &fh, pages[0]));
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testdirect.bin"));
+	setIOMode(SM_IO_FILE);
+
+	freePageBuffer(pages[0]);
+	free(raw);
+
+	TEST_DONE();
+}
+
+void
+testChecksums (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+	SM_PageHandle pages[2] = {allocPageBuffer(), allocPageBuffer()};
+	SM_Completion done;
+	int fd;
+
+	testName = "test page checksums";
+
+	TEST_CHECK(createPageFile("testcrc.bin"));
+	TEST_CHECK(openPageFile("testcrc.bin", &fh));
+
+	// a page never written is all zeros, trailer included, and is accepted
+	TEST_CHECK(appendEmptyBlock(&fh));
+	TEST_CHECK(readBlock(1, &fh, ph));
+	ASSERT_TRUE(ph[0] == 0 && ph[PAGE_SIZE - 1] == 0, "empty page read without a trailer");
+
+	fillPage(ph, 1);
+	TEST_CHECK(writeBlock(1, &fh, ph));
+	ASSERT_TRUE(*(unsigned int *) (ph + PAGE_DATA_SIZE) == checksumBytes(ph, PAGE_DATA_SIZE), "trailer stamped on write");
+	TEST_CHECK(closePageFile(&fh));
+
+	// flip one byte of page 1 behind the storage manager's back; the free
+	// space bitmap in front of it puts the page at offset 2 * PAGE_SIZE
+	fd = open("testcrc.bin", O_RDWR);
+	ASSERT_TRUE(pwrite(fd, "X", 1, 2 * PAGE_SIZE + 100) == 1, "page corrupted");
+	close(fd);
+
+	TEST_CHECK(openPageFile("testcrc.bin", &fh));
+	ASSERT_TRUE(readBlock(1, &fh, ph) == RC_CHECKSUM_MISMATCH, "corrupted page detected");
+	ASSERT_TRUE(readBlocks(0, 2, &fh, pages) == RC_CHECKSUM_MISMATCH, "corrupted page detected in a run");
+	TEST_CHECK(readBlockAsync(1, &fh, ph, NULL));
+	ASSERT_TRUE(pollBlockCompletions(&fh, &done, 1, 1) == 1 && done.rc == RC_CHECKSUM_MISMATCH, "corrupted page detected asynchronously");
+	TEST_CHECK(readBlock(0, &fh, ph));
+
+	// rewriting the page repairs it
+	fillPage(ph, 1);
+	TEST_CHECK(writeBlock(1, &fh, ph));
+	TEST_CHECK(readBlock(1, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, 1), "rewritten page read back");
+
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testcrc.bin"));
+	freePageBuffer(ph);
+	freePageBuffer(pages[0]);
+	freePageBuffer(pages[1]);
+
+	TEST_DONE();
+}
+
+void
+testCompressedBackend (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+	struct stat st;
+	off_t size = 0;
+
+	testName = "test compressed backend";
+
+	checkRoundTrip(SM_IO_COMPRESSED, "testcz.bin");
+
+	setIOMode(SM_IO_COMPRESSED);
+	TEST_CHECK(createPageFile("testcz.bin"));
+	TEST_CHECK(openPageFile("testcz.bin", &fh));
+	TEST_CHECK(ensureCapacity(RT_PAGES, &fh));
+	TEST_CHECK(closePageFile(&fh));
+
+	// pages that keep outgrowing their extents and a map stored on every
+	// sync leave space behind, which the next open finds and reuses
+	for (int round = 0; round < 10; round++)
+	{
+		TEST_CHECK(openPageFile("testcz.bin", &fh));
+		for (int i = 0; i < RT_PAGES; i++)
+		{
+			for (int j = 0; j < PAGE_DATA_SIZE; j++)
+				ph[j] = (char) rand();
+			TEST_CHECK(writeBlock(i, &fh, ph));
+		}
+		TEST_CHECK(syncPageFile(&fh));
+		for (int i = 0; i < RT_PAGES; i++)
+		{
+			fillPage(ph, round * RT_PAGES + i);
+			TEST_CHECK(writeBlock(i, &fh, ph));
+		}
+		TEST_CHECK(closePageFile(&fh));
+
+		stat("testcz.bin", &st);
+		if (round == 1)
+			size = st.st_size;
+	}
+	ASSERT_TRUE(st.st_size <= size, "file does not grow from round to round");
+	ASSERT_TRUE(st.st_size < (RT_PAGES + 4) * PAGE_SIZE, "file holds about one copy of every page");
+
+	TEST_CHECK(openPageFile("testcz.bin", &fh));
+	for (int i = 0; i < RT_PAGES; i++)
+	{
+		TEST_CHECK(readBlock(i, &fh, ph));
+		ASSERT_TRUE(pageHolds(ph, 9 * RT_PAGES + i), "last round read back");
+	}
+	TEST_CHECK(closePageFile(&fh));
+
+	// the file has to be opened in the mode it was created in
+	setIOMode(SM_IO_FILE);
+	TEST_CHECK(createPageFile("testcz.bin"));
+	setIOMode(SM_IO_COMPRESSED);
+	ASSERT_TRUE(openPageFile("testcz.bin", &fh) == RC_IO_MODE_NOT_SUPPORTED, "plain file refused");
+	TEST_CHECK(destroyPageFile("testcz.bin"));
+	setIOMode(SM_IO_FILE);
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+void
+testPageRecycling (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+	SM_PageHandle run[4];
+	PageNumber pageNum;
+
+	testName = "test page allocation and recycling";
+
+	TEST_CHECK(createPageFile("testfsm.bin"));
+	TEST_CHECK(openPageFile("testfsm.bin", &fh));
+	for (int i = 0; i < 20; i++)
+	{
+		fillPage(ph, i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+
+	// freed pages are handed out again lowest first, then the file grows
+	TEST_CHECK(freePage(&fh, 7));
+	TEST_CHECK(freePage(&fh, 5));
+	TEST_CHECK(freePage(&fh, 7));
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_TRUE(pageNum == 5, "lowest free page reused");
+	TEST_CHECK(readBlock(5, &fh, ph));
+	ASSERT_TRUE(ph[0] == 0 && ph[PAGE_DATA_SIZE - 1] == 0, "reused page is empty");
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_TRUE(pageNum == 7, "next free page reused");
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_TRUE(pageNum == 20 && fh.totalNumPages == 21, "file grows once nothing is free");
+	TEST_CHECK(readBlock(6, &fh, ph));
+	ASSERT_TRUE(pageHolds(ph, 6), "neighbour of a freed page untouched");
+	ASSERT_ERROR(freePage(&fh, 21), "no page past the last one");
+
+	// the free pages are recorded in the file
+	TEST_CHECK(freePage(&fh, 12));
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(openPageFile("testfsm.bin", &fh));
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_TRUE(pageNum == 12, "free page survives reopening");
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_TRUE(pageNum == 21, "nothing else was free");
+
+	// pages on both sides of the second bitmap, which sits between them on disk
+	TEST_CHECK(ensureCapacity(FSM_GROUP + 2, &fh));
+	for (int i = FSM_GROUP - 2; i < FSM_GROUP + 2; i++)
+	{
+		fillPage(ph, i);
+		TEST_CHECK(writeBlock(i, &fh, ph));
+	}
+	TEST_CHECK(freePage(&fh, FSM_GROUP));
+	TEST_CHECK(freePage(&fh, FSM_GROUP - 1));
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(openPageFile("testfsm.bin", &fh));
+	ASSERT_TRUE(fh.totalNumPages == FSM_GROUP + 2, "page count survives reopening");
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_TRUE(pageNum == FSM_GROUP - 1, "last page of the first group reused");
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_TRUE(pageNum == FSM_GROUP, "first page of the second group reused");
+
+	// one run across the boundary skips the bitmap between the pages
+	for (int i = 0; i < 4; i++)
+		run[i] = allocPageBuffer();
+	TEST_CHECK(readBlocks(FSM_GROUP - 2, 4, &fh, run));
+	ASSERT_TRUE(pageHolds(run[0], FSM_GROUP - 2), "page before the boundary untouched");
+	ASSERT_TRUE(run[1][0] == 0 && run[2][0] == 0, "reused pages are empty");
+	ASSERT_TRUE(pageHolds(run[3], FSM_GROUP + 1), "page after the boundary untouched");
+	for (int i = 0; i < 4; i++)
+		freePageBuffer(run[i]);
+	TEST_CHECK(allocatePage(&fh, &pageNum));
+	ASSERT_TRUE(pageNum == FSM_GROUP + 2, "file grows past the second group's pages");
+
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile("testfsm.bin"));
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+void
+testMemoryBackend (void)
+{
+	SM_FileHandle fh;
+	SM_PageHandle ph = allocPageBuffer();
+	SM_PageHandle ptr;
+	struct stat st;
+
+	testName = "test in-memory backend";
+
+	checkRoundTrip(SM_IO_MEMORY, "testmem.bin");
+
+	// the file lives in memory only and outlives closing it
+	setIOMode(SM_IO_MEMORY);
+	TEST_CHECK(createPageFile("testmem.bin"));
+	ASSERT_TRUE(stat("testmem.bin", &st) != 0, "nothing written to disk");
+	TEST_CHECK(openPageFile("testmem.bin", &fh));
+	TEST_CHECK(ensureCapacity(3, &fh));
+	fillPage(ph, 2);
+	TEST_CHECK(writeBlock(2, &fh, ph));
+	TEST_CHECK(syncPageFile(&fh));
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(openPageFile("testmem.bin", &fh));
+	TEST_CHECK(getBlockPtr(2, &fh, &ptr));
+	ASSERT_TRUE(pageHolds(ptr, 2), "page kept after closing");
+	TEST_CHECK(readBlock(1, &fh, ph));
+	ASSERT_TRUE(ph[0] == 0 && ph[PAGE_DATA_SIZE - 1] == 0, "page never written is empty");
+	TEST_CHECK(closePageFile(&fh));
+
+	// destroying it is the end of it
+	TEST_CHECK(destroyPageFile("testmem.bin"));
+	ASSERT_ERROR(openPageFile("testmem.bin", &fh), "destroyed file is gone");
+	setIOMode(SM_IO_FILE);
+	freePageBuffer(ph);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+// a page whose first bytes name the value it was filled with
+void
+fillPage (SM_PageHandle ph, int value)
+{
+	memset(ph, 0, PAGE_SIZE);
+	sprintf(ph, "page %d", value);
+	ph[PAGE_DATA_SIZE - 1] = (char) (value % 100 + 1);
+}
+
+int
+pageHolds (SM_PageHandle ph, int value)
+{
+	return strncmp(ph, "page ", 5) == 0 && atoi(ph + 5) == value
+		&& ph[PAGE_DATA_SIZE - 1] == (char) (value % 100 + 1);
+}
+
+// writes a new file page by page, reads it back in one run, as an unordered
+// list and asynchronously, then once more after reopening it
+void
+checkRoundTrip (SM_IOMode mode, char *fileName)
+{
+	SM_FileHandle fh;
+	SM_PageHandle pages[RT_PAGES];
+	SM_Completion done[RT_PAGES];
+	PageNumber list[] = {9, 2, 14, 3, 0, 15};
+	int numList = sizeof(list) / sizeof(list[0]);
+	int got, n;
+
+	setIOMode(mode);
+	for (int i = 0; i < RT_PAGES; i++)
+		pages[i] = allocPageBuffer();
+
+	TEST_CHECK(createPageFile(fileName));
+	TEST_CHECK(openPageFile(fileName, &fh));
+	for (int i = 0; i < RT_PAGES; i++)
+	{
+		fillPage(pages[i], i);
+		TEST_CHECK(writeBlock(i, &fh, pages[i]));
+	}
+	ASSERT_TRUE(fh.totalNumPages == RT_PAGES, "writing past the end grows the file");
+
+	for (int i = 0; i < RT_PAGES; i++)
+		memset(pages[i], 0, PAGE_SIZE);
+	TEST_CHECK(readBlocks(0, RT_PAGES, &fh, pages));
+	for (int i = 0; i < RT_PAGES; i++)
+		ASSERT_TRUE(pageHolds(pages[i], i), "run of pages read back");
+
+	for (int i = 0; i < numList; i++)
+		memset(pages[i], 0, PAGE_SIZE);
+	TEST_CHECK(readBlockList(list, numList, &fh, pages));
+	for (int i = 0; i < numList; i++)
+		ASSERT_TRUE(pageHolds(pages[i], list[i]), "list of pages read back in its order");
+
+	// overwrite every page asynchronously, then read them the same way
+	for (int i = 0; i < RT_PAGES; i++)
+	{
+		fillPage(pages[i], RT_PAGES + i);
+		TEST_CHECK(writeBlockAsync(i, &fh, pages[i], NULL));
+	}
+	for (got = 0; got < RT_PAGES; got += n)
+	{
+		n = pollBlockCompletions(&fh, done, 1, RT_PAGES);
+		ASSERT_TRUE(n > 0, "asynchronous writes complete");
+		for (int j = 0; j < n; j++)
+			TEST_CHECK(done[j].rc);
+	}
+	for (int i = 0; i < RT_PAGES; i++)
+	{
+		memset(pages[i], 0, PAGE_SIZE);
+		TEST_CHECK(readBlockAsync(i, &fh, pages[i], NULL));
+	}
+	for (got = 0; got < RT_PAGES; got += n)
+	{
+		n = pollBlockCompletions(&fh, done, 1, RT_PAGES);
+		ASSERT_TRUE(n > 0, "asynchronous reads complete");
+		for (int j = 0; j < n; j++)
+			TEST_CHECK(done[j].rc);
+	}
+	for (int i = 0; i < RT_PAGES; i++)
+		ASSERT_TRUE(pageHolds(pages[i], RT_PAGES + i), "asynchronous round trip");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(openPageFile(fileName, &fh));
+	ASSERT_TRUE(fh.totalNumPages == RT_PAGES, "page count survives reopening");
+	for (int i = RT_PAGES - 1; i >= 0; i--)
+	{
+		TEST_CHECK(readBlock(i, &fh, pages[0]));
+		ASSERT_TRUE(pageHolds(pages[0], RT_PAGES + i), "pages survive reopening");
+	}
+	TEST_CHECK(closePageFile(&fh));
+	TEST_CHECK(destroyPageFile(fileName));
+
+	for (int i = 0; i < RT_PAGES; i++)
+		freePageBuffer(pages[i]);
+	setIOMode(SM_IO_FILE);
+}
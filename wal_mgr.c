@@ -0,0 +1,330 @@
+#define _FILE_OFFSET_BITS 64 // logs may grow past 2 GB between checkpoints
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "wal_mgr.h"
+
+// The log is a plain file of records back to back, each a header followed by
+// a page image. The LSN of a record is the offset where it ends, so the log
+// is durable up to an LSN once the file is synced up to that offset.
+typedef struct WAL_RecordHeader
+{
+    uint32_t crc;    // CRC32C of the whole record, computed with this field 0
+    uint32_t fileId; // SM_FileHandle.fileId of the page file
+    int64_t pageNum;
+    int64_t length;  // bytes of page image following the header
+} WAL_RecordHeader;
+
+// Records are appended to an in-memory buffer. Writing it out swaps in a
+// second buffer, so appends carry on while the first one is on its way to
+// the disk.
+#define WAL_BUFFER_SIZE (1024 * 1024)
+
+// Bookkeeping stored in WAL_LogHandle.mgmtInfo while a log is open
+typedef struct WAL_Mgmt
+{
+    int fd;
+    pthread_mutex_t lock;
+    pthread_cond_t writtenOut; // broadcast when a write out finished
+    char *buf;                 // records appended since the last write out
+    char *spare;               // the other buffer, written out while flushing
+    size_t bufLen;
+    LSN bufStart;   // log offset of buf[0]
+    LSN endLsn;     // end of the last record appended
+    LSN durableLsn; // everything before this has been synced
+    int flushing;   // a thread is writing out spare
+    int failed;     // a write out failed, the log cannot be relied on
+} WAL_Mgmt;
+
+#define LOG_MGMT(log) ((WAL_Mgmt *)(log)->mgmtInfo)
+
+static RC writeLogAt(int fd, off_t offset, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, buf, len, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return RC_WRITE_FAILED;
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return RC_OK;
+}
+
+// bytes read, less than len at the end of the log
+static size_t readLogAt(int fd, off_t offset, char *buf, size_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        ssize_t n = pread(fd, buf + done, len - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+// Write the buffered records to the log file and sync it when asked to.
+// Called with the lock held while no other write out runs; the lock is let go
+// for the I/O. Whoever syncs makes the records of every waiting committer
+// durable at once (group commit).
+static RC writeOut(WAL_Mgmt *mgmt, int sync)
+{
+    char *data = (*mgmt).buf;
+    size_t len = (*mgmt).bufLen;
+    off_t offset = (*mgmt).bufStart;
+    LSN target = (*mgmt).endLsn;
+
+    (*mgmt).flushing = 1;
+    (*mgmt).buf = (*mgmt).spare;
+    (*mgmt).spare = data;
+    (*mgmt).bufLen = 0;
+    (*mgmt).bufStart = target;
+    pthread_mutex_unlock(&(*mgmt).lock);
+
+    RC code = writeLogAt((*mgmt).fd, offset, data, len);
+    if (code == RC_OK && sync && fdatasync((*mgmt).fd) != 0)
+        code = RC_WRITE_FAILED;
+
+    pthread_mutex_lock(&(*mgmt).lock);
+    (*mgmt).flushing = 0;
+    if (code != RC_OK)
+        (*mgmt).failed = 1;
+    else if (sync)
+        (*mgmt).durableLsn = target;
+    pthread_cond_broadcast(&(*mgmt).writtenOut);
+    return code;
+}
+
+extern RC openLog(char *fileName, WAL_LogHandle *log)
+{
+    struct stat fileinfo;
+    WAL_Mgmt *mgmt = (WAL_Mgmt *)calloc(1, sizeof(WAL_Mgmt));
+
+    if (mgmt == NULL)
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+
+    (*mgmt).buf = (char *)malloc(WAL_BUFFER_SIZE);
+    (*mgmt).spare = (char *)malloc(WAL_BUFFER_SIZE);
+    if ((*mgmt).buf == NULL || (*mgmt).spare == NULL)
+    {
+        free((*mgmt).buf);
+        free((*mgmt).spare);
+        free(mgmt);
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    }
+
+    (*mgmt).fd = open(fileName, O_RDWR | O_CREAT, 0644);
+    if ((*mgmt).fd < 0 || fstat((*mgmt).fd, &fileinfo) != 0)
+    {
+        if ((*mgmt).fd >= 0)
+            close((*mgmt).fd);
+        free((*mgmt).buf);
+        free((*mgmt).spare);
+        free(mgmt);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    // new records go after the ones already in the file
+    (*mgmt).bufStart = fileinfo.st_size;
+    (*mgmt).endLsn = fileinfo.st_size;
+    (*mgmt).durableLsn = fileinfo.st_size;
+    pthread_mutex_init(&(*mgmt).lock, NULL);
+    pthread_cond_init(&(*mgmt).writtenOut, NULL);
+
+    (*log).fileName = fileName;
+    (*log).mgmtInfo = mgmt;
+    return RC_OK;
+}
+
+extern RC closeLog(WAL_LogHandle *log)
+{
+    WAL_Mgmt *mgmt = LOG_MGMT(log);
+    RC code = RC_OK;
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    // records not committed yet are written, like pages on closePageFile
+    pthread_mutex_lock(&(*mgmt).lock);
+    while ((*mgmt).flushing)
+        pthread_cond_wait(&(*mgmt).writtenOut, &(*mgmt).lock);
+    if ((*mgmt).bufLen > 0 && !(*mgmt).failed)
+        code = writeOut(mgmt, 0);
+    pthread_mutex_unlock(&(*mgmt).lock);
+
+    close((*mgmt).fd);
+    pthread_mutex_destroy(&(*mgmt).lock);
+    pthread_cond_destroy(&(*mgmt).writtenOut);
+    free((*mgmt).buf);
+    free((*mgmt).spare);
+    free(mgmt);
+    (*log).mgmtInfo = NULL;
+    return code;
+}
+
+extern RC destroyLog(char *fileName)
+{
+    return unlink(fileName) == 0 ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+extern RC appendLogRecord(WAL_LogHandle *log, SM_FileHandle *fHandle, PageNumber pageNum, const char *page, LSN *lsn)
+{
+    WAL_Mgmt *mgmt = LOG_MGMT(log);
+    size_t recordLen = sizeof(WAL_RecordHeader) + (*fHandle).pageSize;
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    pthread_mutex_lock(&(*mgmt).lock);
+
+    // make room by writing the buffer out, or wait for whoever is doing so
+    while (!(*mgmt).failed && (*mgmt).bufLen + recordLen > WAL_BUFFER_SIZE)
+    {
+        if ((*mgmt).flushing)
+            pthread_cond_wait(&(*mgmt).writtenOut, &(*mgmt).lock);
+        else
+            writeOut(mgmt, 0);
+    }
+    if ((*mgmt).failed)
+    {
+        pthread_mutex_unlock(&(*mgmt).lock);
+        return RC_WRITE_FAILED;
+    }
+
+    char *record = (*mgmt).buf + (*mgmt).bufLen;
+    WAL_RecordHeader header;
+    header.crc = 0;
+    header.fileId = (*fHandle).fileId;
+    header.pageNum = pageNum;
+    header.length = (*fHandle).pageSize;
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), page, (*fHandle).pageSize);
+    header.crc = checksumBytes(record, recordLen);
+    memcpy(record, &header.crc, sizeof(header.crc));
+
+    (*mgmt).bufLen += recordLen;
+    (*mgmt).endLsn += recordLen;
+    *lsn = (*mgmt).endLsn;
+
+    pthread_mutex_unlock(&(*mgmt).lock);
+    return RC_OK;
+}
+
+extern RC commitLog(WAL_LogHandle *log, LSN lsn)
+{
+    WAL_Mgmt *mgmt = LOG_MGMT(log);
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    pthread_mutex_lock(&(*mgmt).lock);
+
+    // an LSN from before truncateLog is covered by the checkpoint
+    if (lsn > (*mgmt).endLsn)
+        lsn = (*mgmt).endLsn;
+
+    // A sync already under way may not include our records: wait for it and
+    // then sync everything appended meanwhile, unless another committer has
+    // done so first.
+    while (!(*mgmt).failed && (*mgmt).durableLsn < lsn)
+    {
+        if ((*mgmt).flushing)
+            pthread_cond_wait(&(*mgmt).writtenOut, &(*mgmt).lock);
+        else
+            writeOut(mgmt, 1);
+    }
+
+    RC code = (*mgmt).failed ? RC_WRITE_FAILED : RC_OK;
+    pthread_mutex_unlock(&(*mgmt).lock);
+    return code;
+}
+
+extern RC replayLog(WAL_LogHandle *log, SM_FileHandle *fHandle)
+{
+    WAL_Mgmt *mgmt = LOG_MGMT(log);
+    size_t recordLen = sizeof(WAL_RecordHeader) + (*fHandle).pageSize;
+    RC code = RC_OK;
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    char *record = (char *)malloc(recordLen);
+    SM_PageHandle page = allocPageBufferOf((*fHandle).pageSize);
+    if (record == NULL || page == NULL)
+    {
+        free(record);
+        freePageBuffer(page);
+        return RC_MELLOC_MEM_ALLOC_FAILED;
+    }
+
+    // records still buffered are already applied to the pages in memory
+    for (LSN offset = 0; offset + (LSN)recordLen <= (*mgmt).bufStart && code == RC_OK; offset += recordLen)
+    {
+        WAL_RecordHeader header;
+
+        if (readLogAt((*mgmt).fd, offset, record, recordLen) != recordLen)
+            break;
+        memcpy(&header, record, sizeof(header));
+        if (header.fileId != (*fHandle).fileId || header.length != (*fHandle).pageSize || header.pageNum < 0)
+            break;
+        memset(record, 0, sizeof(header.crc));
+        if (checksumBytes(record, recordLen) != header.crc)
+            break; // torn by the crash
+
+        memcpy(page, record + sizeof(header), (*fHandle).pageSize);
+        code = ensureCapacity(header.pageNum + 1, fHandle);
+        if (code == RC_OK)
+            code = writeBlock(header.pageNum, fHandle, page);
+    }
+
+    if (code == RC_OK)
+        code = syncPageFile(fHandle);
+
+    free(record);
+    freePageBuffer(page);
+    return code;
+}
+
+extern RC truncateLog(WAL_LogHandle *log)
+{
+    WAL_Mgmt *mgmt = LOG_MGMT(log);
+    RC code = RC_OK;
+
+    if (mgmt == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    pthread_mutex_lock(&(*mgmt).lock);
+    while ((*mgmt).flushing)
+        pthread_cond_wait(&(*mgmt).writtenOut, &(*mgmt).lock);
+
+    if (ftruncate((*mgmt).fd, 0) != 0 || fsync((*mgmt).fd) != 0)
+        code = RC_WRITE_FAILED;
+    else
+    {
+        (*mgmt).bufLen = 0;
+        (*mgmt).bufStart = 0;
+        (*mgmt).endLsn = 0;
+        (*mgmt).durableLsn = 0;
+        (*mgmt).failed = 0;
+    }
+
+    pthread_mutex_unlock(&(*mgmt).lock);
+    return code;
+}
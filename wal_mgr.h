@@ -0,0 +1,46 @@
+#ifndef WAL_MGR_H
+#define WAL_MGR_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+
+/************************************************************
+ *                    handle data structures                *
+ ************************************************************/
+
+/* position in a log: the byte offset just past a record */
+typedef long long LSN;
+
+typedef struct WAL_LogHandle {
+  char *fileName;
+
+  void *mgmtInfo;
+} WAL_LogHandle;
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+/* A write-ahead log holds full images of modified pages, appended in memory
+ * and written out sequentially. commitLog makes the records up to an LSN
+ * durable; callers committing at the same time share one fdatasync. A page
+ * may only be written to its page file once the log is durable up to the
+ * LSN of its last record. After a crash replayLog writes the logged images
+ * back, so the page file holds every committed change. */
+extern RC openLog (char *fileName, WAL_LogHandle *log); /* created if missing */
+extern RC closeLog (WAL_LogHandle *log);
+extern RC destroyLog (char *fileName);
+
+/* log the image of page pageNum of the open page file fHandle; *lsn is
+ * where its record ends */
+extern RC appendLogRecord (WAL_LogHandle *log, SM_FileHandle *fHandle, PageNumber pageNum, const char *page, LSN *lsn);
+/* block until every record ending at or before lsn is durable */
+extern RC commitLog (WAL_LogHandle *log, LSN lsn);
+
+/* write the pages logged for fHandle back into it in log order and sync it;
+ * a record torn by the crash, or logged for an earlier file of the same
+ * name, ends the replay */
+extern RC replayLog (WAL_LogHandle *log, SM_FileHandle *fHandle);
+/* drop all records; only once the pages they hold are synced to the page file */
+extern RC truncateLog (WAL_LogHandle *log);
+
+#endif